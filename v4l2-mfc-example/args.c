@@ -21,6 +21,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <linux/videodev2.h>
@@ -34,13 +35,29 @@ void print_usage(char *name)
 	// "d:f:i:m:c:V"
 	printf("Usage:\n");
 	printf("\t./%s\n", name);
+	printf("\t-b <KiB> - Size of the stream buffers, by default chosen\n");
+	printf("\t\t     from the largest frame\n");
 	printf("\t-c <codec> - The codec of the encoded stream\n");
-	printf("\t\t     Available codecs: mpeg4, h264\n");
+	printf("\t\t     Available codecs: mpeg4, h264, hevc, h263, xvid,\n");
+	printf("\t\t     mpeg2, mpeg1, vc1, rcv, vp8\n");
 	printf("\t-d <device>  - Frame buffer device (e.g. /dev/fb0)\n");
+	printf("\t-D - pass the decoded frames to FIMC as DMABUF\n");
+	printf("\t-e - Decode in a single thread driven by poll()\n");
 	printf("\t-f <device> - FIMC device (e.g. /dev/video4)\n");
-	printf("\t-i <file> - Input file name\n");
+	printf("\t-i <file> - Input file name, \"-\" for stdin. Pipes and FIFOs\n");
+	printf("\t\t     are read as a stream. Up to %d inputs can be\n",
+								MAX_STREAMS);
+	printf("\t\t     given, they are shown as a mosaic\n");
+	printf("\t-l <KiB> - Memory limit for the stream buffers\n");
 	printf("\t-m <device> - MFC device (e.g. /dev/video8)\n");
+	printf("\t-n <count> - Number of the stream buffers\n");
+	printf("\t-p <pid> - PID of the video stream in a transport stream\n");
+	printf("\t-s <frame> - Start decoding from the key frame before frame\n");
+	printf("\t-S <file> - Write the statistics of the stream as JSON,\n");
+	printf("\t\t     \"-\" for stdout, the messages go to stderr then\n");
+	printf("\t-u - queue the stream with USERPTR from the input file\n");
 	printf("\t-V - synchronise to vsync\n");
+	printf("\t-x <file> - Frame index, built if missing or stale\n");
 	//printf("\t- <device> - \n");
 	printf("\tp2\n");
 	printf("\n");
@@ -49,6 +66,8 @@ void print_usage(char *name)
 void init_to_defaults(struct instance *i)
 {
 	memset(i, 0, sizeof(*i));
+	i->mfc.out_memory = V4L2_MEMORY_MMAP;
+	i->fimc.out_memory = V4L2_MEMORY_USERPTR;
 }
 
 int get_codec(char *str)
@@ -57,6 +76,9 @@ int get_codec(char *str)
 		return V4L2_PIX_FMT_MPEG4;
 	} else if (strncasecmp("h264", str, 5) == 0) {
 		return V4L2_PIX_FMT_H264;
+	} else if (strncasecmp("hevc", str, 5) == 0 ||
+				strncasecmp("h265", str, 5) == 0) {
+		return V4L2_PIX_FMT_HEVC;
 	} else if (strncasecmp("h263", str, 5) == 0) {
 		return V4L2_PIX_FMT_H263;
 	} else if (strncasecmp("xvid", str, 5) == 0) {
@@ -65,67 +87,163 @@ int get_codec(char *str)
 		return V4L2_PIX_FMT_MPEG2;
 	} else if (strncasecmp("mpeg1", str, 5) == 0) {
 		return V4L2_PIX_FMT_MPEG1;
+	} else if (strncasecmp("vc1", str, 4) == 0) {
+		return V4L2_PIX_FMT_VC1_ANNEX_G;
+	} else if (strncasecmp("rcv", str, 4) == 0) {
+		return V4L2_PIX_FMT_VC1_ANNEX_L;
+	} else if (strncasecmp("vp8", str, 4) == 0) {
+		return V4L2_PIX_FMT_VP8;
 	}
 	return 0;
 }
 
-int parse_args(struct instance *i, int argc, char **argv)
+/* Choose the parser of the codec of the stream */
+int set_parser(struct instance *i)
 {
-	int c;
+	if (!i->parser.codec) {
+		err("Unknown or not set codec (-c)");
+		return -1;
+	}
+
+	switch (i->parser.codec) {
+	case V4L2_PIX_FMT_XVID:
+	case V4L2_PIX_FMT_H263:
+	case V4L2_PIX_FMT_MPEG4:
+		i->parser.func = parse_mpeg4_stream;
+		break;
+	case V4L2_PIX_FMT_H264:
+		i->parser.func = parse_h264_stream;
+		break;
+	case V4L2_PIX_FMT_HEVC:
+		i->parser.func = parse_hevc_stream;
+		break;
+	case V4L2_PIX_FMT_MPEG1:
+	case V4L2_PIX_FMT_MPEG2:
+		i->parser.func = parse_mpeg2_stream;
+		break;
+	case V4L2_PIX_FMT_VC1_ANNEX_G:
+		i->parser.func = parse_vc1_stream;
+		break;
+	case V4L2_PIX_FMT_VC1_ANNEX_L:
+		i->parser.func = parse_vc1_rcv_stream;
+		break;
+	case V4L2_PIX_FMT_VP8:
+		i->parser.func = parse_vp8_ivf_stream;
+		break;
+	}
+
+	return 0;
+}
+
+int parse_args(struct instance *inst, int *count, int argc, char **argv)
+{
+	struct instance *i = &inst[0];
+	unsigned long codecs[MAX_STREAMS];
+	char *names[MAX_STREAMS];
+	int stdin_used = 0;
+	int c, n = 0;
 
 	init_to_defaults(i);
 
-	while ((c = getopt(argc, argv, "c:d:f:i:m:V")) != -1) {
+	while ((c = getopt(argc, argv, "b:c:d:Def:i:l:m:n:p:s:S:uVx:")) != -1) {
 		switch (c) {
+		case 'b':
+			i->mfc.out_req_size = atoi(optarg) * 1024;
+			break;
 		case 'c':
 			i->parser.codec = get_codec(optarg);
 			break;
 		case 'd':
 			i->fb.name = optarg;
 			break;
+		case 'D':
+			i->fimc.out_memory = V4L2_MEMORY_DMABUF;
+			break;
+		case 'e':
+			i->event_loop = 1;
+			break;
 		case 'f':
 			i->fimc.name = optarg;
 			break;
 		case 'i':
-			i->in.name = optarg;
+			if (n == MAX_STREAMS) {
+				err("At most %d inputs can be decoded",
+								MAX_STREAMS);
+				return -1;
+			}
+			if (strcmp(optarg, "-") == 0 && stdin_used++) {
+				err("Only one input can be read from stdin");
+				return -1;
+			}
+			/* The codec chosen so far, the last one if none */
+			codecs[n] = i->parser.codec;
+			names[n++] = optarg;
+			break;
+		case 'l':
+			i->mfc.out_mem_limit = atoi(optarg) * 1024;
 			break;
 		case 'm':
 			i->mfc.name = optarg;
 			break;
+		case 'n':
+			i->mfc.out_req_cnt = atoi(optarg);
+			if (i->mfc.out_req_cnt < 1 ||
+				i->mfc.out_req_cnt > MFC_MAX_OUT_BUF) {
+				err("The number of stream buffers has to be "
+					"between 1 and %d", MFC_MAX_OUT_BUF);
+				return -1;
+			}
+			break;
+		case 'p':
+			i->in.ts_pid = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			i->parser.seek = atoi(optarg);
+			break;
+		case 'S':
+			i->parser.stats_name = optarg;
+			break;
+		case 'u':
+			i->mfc.out_memory = V4L2_MEMORY_USERPTR;
+			break;
 		case 'V':
 			i->fb.double_buf = 1;
 			break;
+		case 'x':
+			i->index.name = optarg;
+			break;
 		default:
 			err("Bad argument");
 			return -1;
 		}
 	}
 
-	if (!i->in.name || !i->fb.name || !i->fimc.name || !i->mfc.name) {
+	if (!n || !i->fb.name || !i->fimc.name || !i->mfc.name) {
 		err("The following arguments are required: -d -f -i -m -c");
 		return -1;
 	}
 
-	if (!i->parser.codec) {
-		err("Unknown or not set codec (-c)");
+	if (n > 1 && (i->index.name || i->parser.stats_name ||
+						i->fb.double_buf)) {
+		err("-x, -S and -V can only be used with one input");
 		return -1;
 	}
 
-	switch (i->parser.codec) {
-	case V4L2_PIX_FMT_XVID:
-	case V4L2_PIX_FMT_H263:
-	case V4L2_PIX_FMT_MPEG4:
-		i->parser.func = parse_mpeg4_stream;
-		break;
-	case V4L2_PIX_FMT_H264:
-		i->parser.func = parse_h264_stream;
-		break;
-	case V4L2_PIX_FMT_MPEG1:
-	case V4L2_PIX_FMT_MPEG2:
-		i->parser.func = parse_mpeg2_stream;
-		break;
+	/* Several streams are decoded by one thread, in turns */
+	if (n > 1)
+		i->event_loop = 1;
+
+	/* The other options are the same for all the streams */
+	for (c = 1; c < n; c++)
+		inst[c] = *i;
+	for (c = 0; c < n; c++) {
+		inst[c].in.name = names[c];
+		if (codecs[c])
+			inst[c].parser.codec = codecs[c];
+		if (set_parser(&inst[c]))
+			return -1;
 	}
+	*count = n;
 
 	return 0;
 }
-
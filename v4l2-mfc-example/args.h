@@ -26,8 +26,10 @@
 
 /* Pritn usage information of the application */
 void print_usage(char *name);
-/* Parse the arguments that have been given to the application */
-int parse_args(struct instance *i, int argc, char **argv);
+/* Parse the arguments that have been given to the application. Every
+ * input file gets its own instance in the array, count is set to their
+ * number. */
+int parse_args(struct instance *inst, int *count, int argc, char **argv);
 
 #endif /* INCLUDE_FILEOPS_H */
 
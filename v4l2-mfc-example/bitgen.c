@@ -0,0 +1,492 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Synthetic stream generator
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitgen.h"
+#include "common.h"
+
+/* Macroblock rows and columns of the generated 1280x720 H264 and 720x576
+ * MPEG2 pictures, used to spread the slices over the picture */
+#define BITGEN_H264_MBS		(80 * 45)
+#define BITGEN_MPEG2_ROWS	36
+
+struct bitgen {
+	char *p;
+	int size;
+	/* Bits that have not been written yet */
+	unsigned int acc;
+	int bits;
+	/* Emulation prevention for H264 and HEVC */
+	int epb;
+	int zeros;
+	unsigned int rnd;
+	struct bitgen_params *params;
+};
+
+static unsigned int gen_rand(struct bitgen *g)
+{
+	/* xorshift32 */
+	g->rnd ^= g->rnd << 13;
+	g->rnd ^= g->rnd >> 17;
+	g->rnd ^= g->rnd << 5;
+	return g->rnd;
+}
+
+static void gen_byte(struct bitgen *g, unsigned char b)
+{
+	if (g->epb && g->zeros >= 2 && b <= 3) {
+		g->p[g->size++] = 3;
+		g->zeros = 0;
+	}
+	g->p[g->size++] = b;
+	g->zeros = b ? 0 : g->zeros + 1;
+}
+
+static void gen_bits(struct bitgen *g, int n, unsigned int v)
+{
+	while (n--) {
+		g->acc = (g->acc << 1) | ((v >> n) & 1);
+		if (++g->bits == 8) {
+			gen_byte(g, g->acc);
+			g->acc = 0;
+			g->bits = 0;
+		}
+	}
+}
+
+/* Exp-Golomb code */
+static void gen_ue(struct bitgen *g, unsigned int v)
+{
+	int n = 0;
+
+	v++;
+	while ((v >> n) > 1)
+		n++;
+	gen_bits(g, n, 0);
+	gen_bits(g, n + 1, v);
+}
+
+static void gen_align(struct bitgen *g)
+{
+	if (g->bits)
+		gen_bits(g, 8 - g->bits, 0);
+}
+
+/* Start code of a new unit, the long form is used for the first unit of
+ * an H264 or HEVC access unit */
+static void gen_code(struct bitgen *g, int code, int first)
+{
+	gen_align(g);
+	if (first && g->epb)
+		g->p[g->size++] = 0;
+	g->p[g->size++] = 0;
+	g->p[g->size++] = 0;
+	g->p[g->size++] = 1;
+	g->p[g->size++] = code;
+	g->zeros = 0;
+}
+
+/* Random payload of a unit. It ends with a byte that is not zero, like the
+ * stop bit of an RBSP. */
+static void gen_payload(struct bitgen *g, int size)
+{
+	unsigned int r;
+
+	gen_align(g);
+	while (size-- > 1) {
+		r = gen_rand(g);
+		if (r % 1000 < g->params->emulation && size > 3) {
+			gen_byte(g, 0);
+			gen_byte(g, 0);
+			/* Near misses in the streams without emulation
+			 * prevention */
+			gen_byte(g, g->epb ? (r >> 16) & 3 : 2 + (r >> 16) % 254);
+			size -= 2;
+		} else {
+			gen_byte(g, 1 + (r >> 16) % 255);
+		}
+	}
+	gen_byte(g, 0x80);
+}
+
+/* Size of the payload of a slice of the picture n */
+static int gen_slice_size(struct bitgen *g, int key)
+{
+	int size = g->params->frame_size;
+
+	if (key)
+		size *= 2;
+	size = size / 2 + gen_rand(g) % (size + 1);
+	size /= g->params->slices;
+	return size > 8 ? size : 8;
+}
+
+static void gen_h264(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int frame_num = 0;
+	int n, k, key;
+
+	/* Baseline SPS of a 1280x720 stream with pic_order_cnt_type 2 */
+	gen_code(g, 0x67, 1);
+	gen_bits(g, 8, 66);
+	gen_bits(g, 8, 0);
+	gen_bits(g, 8, 31);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 2);
+	gen_ue(g, 1);
+	gen_bits(g, 1, 0);
+	gen_ue(g, 79);
+	gen_ue(g, 44);
+	gen_bits(g, 3, 6);
+	gen_bits(g, 2, 1);
+
+	/* PPS with CAVLC and a single slice group */
+	gen_code(g, 0x68, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_bits(g, 2, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_bits(g, 3, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_ue(g, 0);
+	gen_bits(g, 4, 9);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+		if (key)
+			frame_num = 0;
+
+		for (k = 0; k < p->slices; k++) {
+			gen_code(g, key ? 0x65 : 0x41, k == 0);
+			gen_ue(g, k * BITGEN_H264_MBS / p->slices);
+			gen_ue(g, key ? 7 : 5);
+			gen_ue(g, 0);
+			gen_bits(g, 4, frame_num);
+			if (key)
+				gen_ue(g, (n / p->gop) & 1);
+			gen_payload(g, gen_slice_size(g, key));
+		}
+
+		frame_num = (frame_num + 1) % 16;
+	}
+}
+
+static void gen_hevc(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, k, key;
+
+	/* The parameter sets are not parsed, only their types matter */
+	for (k = 32; k <= 34; k++) {
+		gen_code(g, k << 1, k == 32);
+		gen_byte(g, 1);
+		gen_payload(g, 16);
+	}
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+
+		for (k = 0; k < p->slices; k++) {
+			/* IDR_W_RADL or TRAIL_R */
+			gen_code(g, key ? 19 << 1 : 1 << 1, k == 0);
+			gen_byte(g, 1);
+			/* first_slice_segment_in_pic_flag */
+			gen_byte(g, k == 0 ? 0x80 : 0x40);
+			gen_payload(g, gen_slice_size(g, key));
+		}
+	}
+}
+
+/* MPEG4 video packets are not separated by start codes, so the number of
+ * slices is not used */
+static void gen_mpeg4(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, key;
+
+	gen_code(g, 0xb0, 0);
+	gen_byte(g, 0x08);
+	gen_code(g, 0xb5, 0);
+	gen_byte(g, 0x09);
+	gen_code(g, 0x00, 0);
+	gen_code(g, 0x20, 0);
+	gen_payload(g, 12);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+
+		if (key) {
+			gen_code(g, 0xb3, 0);
+			gen_payload(g, 3);
+		}
+		/* vop_coding_type I or P */
+		gen_code(g, 0xb6, 0);
+		gen_byte(g, key ? 0x10 : 0x50);
+		gen_payload(g, gen_slice_size(g, key) * p->slices);
+	}
+}
+
+/* MPEG2 picture with the given picture_structure */
+static void gen_mpeg2_picture(struct bitgen *g, int n, int key, int structure)
+{
+	struct bitgen_params *p = g->params;
+	int rows = BITGEN_MPEG2_ROWS;
+	int k;
+
+	/* Picture header with picture_coding_type I or P */
+	gen_code(g, 0x00, 0);
+	gen_bits(g, 10, n % p->gop);
+	gen_bits(g, 3, key ? 1 : 2);
+	gen_bits(g, 16, 0xffff);
+	if (!key)
+		gen_bits(g, 4, 1);
+
+	/* Picture coding extension, top_field_first is set for frames */
+	gen_code(g, 0xb5, 0);
+	gen_bits(g, 4, 8);
+	gen_bits(g, 16, key ? 0xffff : 0x11ff);
+	gen_bits(g, 2, 0);
+	gen_bits(g, 2, structure);
+	gen_bits(g, 10, structure == 3 ? 0x306 : 0x004);
+
+	if (structure != 3)
+		rows /= 2;
+	for (k = 0; k < p->slices; k++) {
+		gen_code(g, 1 + k * rows / p->slices, 0);
+		gen_bits(g, 6, 8 << 1);
+		gen_payload(g, gen_slice_size(g, key) /
+						(structure == 3 ? 1 : 2));
+	}
+}
+
+static void gen_mpeg2(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, key;
+
+	/* 720x576, 4:3, 25 fps */
+	gen_code(g, 0xb3, 0);
+	gen_bits(g, 12, 720);
+	gen_bits(g, 12, 576);
+	gen_bits(g, 4, 2);
+	gen_bits(g, 4, 3);
+	gen_bits(g, 18, 20000);
+	gen_bits(g, 1, 1);
+	gen_bits(g, 10, 112);
+	gen_bits(g, 3, 0);
+
+	/* Sequence extension, main profile at main level */
+	gen_code(g, 0xb5, 0);
+	gen_bits(g, 4, 1);
+	gen_bits(g, 8, 0x48);
+	gen_bits(g, 1, !p->fields);
+	gen_bits(g, 2, 1);
+	gen_bits(g, 16, 0);
+	gen_bits(g, 1, 1);
+	gen_bits(g, 16, 0);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+
+		if (key) {
+			gen_code(g, 0xb8, 0);
+			gen_bits(g, 25, 1 << 12);
+			gen_bits(g, 2, 2);
+		}
+
+		if (p->fields) {
+			/* Top field first */
+			gen_mpeg2_picture(g, n, key, 1);
+			gen_mpeg2_picture(g, n, key, 2);
+		} else {
+			gen_mpeg2_picture(g, n, key, 3);
+		}
+	}
+}
+
+/* VC1 advanced profile, the slices after the first one have their own
+ * start codes */
+static void gen_vc1(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, k, key;
+
+	gen_code(g, 0x0f, 0);
+	gen_bits(g, 2, 3);
+	gen_payload(g, 16);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+
+		if (key) {
+			gen_code(g, 0x0e, 0);
+			gen_payload(g, 6);
+		}
+		for (k = 0; k < p->slices; k++) {
+			gen_code(g, k ? 0x0b : 0x0d, 0);
+			gen_payload(g, gen_slice_size(g, key));
+		}
+	}
+}
+
+static void gen_le32(struct bitgen *g, unsigned int v)
+{
+	int k;
+
+	for (k = 0; k < 4; k++)
+		g->p[g->size++] = v >> (8 * k);
+}
+
+/* VC1 main profile in the RCV format, version 2. The frames have no
+ * start codes, so the payload is not escaped and the number of slices is
+ * not used. */
+static void gen_rcv(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, k, key, size;
+
+	gen_le32(g, 0xc5000000 | p->frames);
+	gen_le32(g, 4);
+	/* STRUCT_C of the main profile */
+	gen_le32(g, 0x0000f144);
+	gen_le32(g, 576);
+	gen_le32(g, 720);
+	gen_le32(g, 12);
+	for (k = 0; k < 3; k++)
+		gen_le32(g, 0);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+		size = gen_slice_size(g, key) * p->slices;
+
+		gen_le32(g, size | (key ? 0x80000000 : 0));
+		gen_le32(g, n * 40);
+		gen_payload(g, size);
+	}
+}
+
+/* VP8 in an IVF file. Like in RCV files the frames have no start codes,
+ * only the frame tag and the key frame header are written. */
+static void gen_ivf(struct bitgen *g)
+{
+	struct bitgen_params *p = g->params;
+	int n, key, size;
+
+	memcpy(g->p + g->size, "DKIF", 4);
+	g->size += 4;
+	gen_le32(g, 32 << 16);
+	memcpy(g->p + g->size, "VP80", 4);
+	g->size += 4;
+	gen_le32(g, 1280 | 720 << 16);
+	gen_le32(g, 30);
+	gen_le32(g, 1);
+	gen_le32(g, p->frames);
+	gen_le32(g, 0);
+
+	for (n = 0; n < p->frames; n++) {
+		key = n % p->gop == 0;
+		size = gen_slice_size(g, key) * p->slices;
+		if (size < 10)
+			size = 10;
+
+		gen_le32(g, size);
+		gen_le32(g, n);
+		gen_le32(g, 0);
+		/* Frame tag: type, version 0, shown, first partition size */
+		gen_le32(g, (key ? 0 : 1) | 0x10 | ((size / 2) & 0x7ffff) << 5);
+		g->size--;
+		size -= 3;
+		if (key) {
+			g->p[g->size++] = 0x9d;
+			g->p[g->size++] = 0x01;
+			g->p[g->size++] = 0x2a;
+			gen_le32(g, 1280 | 720 << 16);
+			size -= 7;
+		}
+		gen_payload(g, size);
+	}
+}
+
+int bitgen_stream(const char *codec, struct bitgen_params *p, char **out)
+{
+	void (*gen)(struct bitgen *g);
+	struct bitgen g;
+	long long max;
+
+	if (strcasecmp(codec, "h264") == 0)
+		gen = gen_h264;
+	else if (strcasecmp(codec, "hevc") == 0)
+		gen = gen_hevc;
+	else if (strcasecmp(codec, "mpeg4") == 0)
+		gen = gen_mpeg4;
+	else if (strcasecmp(codec, "mpeg2") == 0)
+		gen = gen_mpeg2;
+	else if (strcasecmp(codec, "vc1") == 0)
+		gen = gen_vc1;
+	else if (strcasecmp(codec, "rcv") == 0)
+		gen = gen_rcv;
+	else if (strcasecmp(codec, "vp8") == 0)
+		gen = gen_ivf;
+	else {
+		err("Cannot generate %s streams", codec);
+		return -1;
+	}
+
+	if (p->frames < 1 || p->frame_size < 1 || p->slices < 1 ||
+		p->gop < 1 || p->emulation < 0 || p->emulation > 333) {
+		err("Invalid parameters of the synthetic stream");
+		return -1;
+	}
+
+	/* A key picture can be three times the average size and emulation
+	 * prevention adds at most half of it */
+	max = (long long)p->frames * (p->frame_size * 9LL / 2 +
+					p->slices * 96LL + 128) + 1024;
+	if (max > INT_MAX) {
+		err("The synthetic stream would be too large");
+		return -1;
+	}
+
+	memzero(g);
+	g.p = malloc(max);
+	if (!g.p) {
+		err("Failed to allocate the synthetic stream");
+		return -1;
+	}
+	g.params = p;
+	g.rnd = p->seed ? p->seed : 1;
+	g.epb = gen == gen_h264 || gen == gen_hevc || gen == gen_vc1;
+
+	gen(&g);
+	gen_align(&g);
+
+	*out = g.p;
+	return g.size;
+}
@@ -0,0 +1,50 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Synthetic stream generator header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef INCLUDE_BITGEN_H
+#define INCLUDE_BITGEN_H
+
+/* Parameters of a synthetic stream */
+struct bitgen_params {
+	/* Number of pictures */
+	int frames;
+	/* Average size of a picture in bytes, key pictures are twice as
+	 * large */
+	int frame_size;
+	/* Number of slices in a picture */
+	int slices;
+	/* Number of 00 00 0x sequences per 1000 payload bytes. In H264, HEVC
+	 * and VC1 they need emulation prevention bytes, in MPEG4 and MPEG2
+	 * they are near misses of a start code. */
+	int emulation;
+	/* Distance between key pictures */
+	int gop;
+	/* Code the MPEG2 pictures as pairs of field pictures */
+	int fields;
+	unsigned int seed;
+};
+
+/* Generate a synthetic elementary stream of the codec (mpeg4, h264, hevc,
+ * mpeg2, vc1, rcv or vp8). The stream is allocated and returned in out.
+ * Returns its size or -1 on error. */
+int	bitgen_stream(const char *codec, struct bitgen_params *p, char **out);
+
+#endif /* INCLUDE_BITGEN_H */
@@ -0,0 +1,138 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Bit reader
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "bits.h"
+
+void bits_init(struct bits *b, const char *p, int size, int emulation)
+{
+	b->p = (const unsigned char *)p;
+	b->end = b->p + (size > 0 ? size : 0);
+	b->cur = 0;
+	b->left = 0;
+	b->zeros = 0;
+	b->emulation = emulation;
+	b->error = 0;
+}
+
+/* Load the next byte of the payload to cur */
+static int bits_next_byte(struct bits *b)
+{
+	unsigned char c;
+
+	while (1) {
+		if (b->p >= b->end) {
+			b->error = 1;
+			return -1;
+		}
+		c = *b->p++;
+
+		if (b->emulation && b->zeros >= 2) {
+			if (c == 0x03) {
+				/* emulation_prevention_three_byte */
+				b->zeros = 0;
+				continue;
+			}
+			if (c < 0x03) {
+				/* Start code of the next NAL unit */
+				b->end = b->p;
+				b->error = 1;
+				return -1;
+			}
+		}
+		break;
+	}
+
+	if (c == 0)
+		b->zeros++;
+	else
+		b->zeros = 0;
+
+	b->cur = c;
+	b->left = 8;
+	return 0;
+}
+
+unsigned int bits_read(struct bits *b, int n)
+{
+	unsigned int val = 0;
+	int k;
+
+	while (n > 0) {
+		if (b->left == 0 && bits_next_byte(b))
+			return 0;
+		k = n < b->left ? n : b->left;
+		b->left -= k;
+		n -= k;
+		val = (val << k) | ((b->cur >> b->left) & ((1 << k) - 1));
+	}
+
+	return val;
+}
+
+unsigned int bits_read_ue(struct bits *b)
+{
+	int zeros = 0;
+
+	while (bits_read(b, 1) == 0) {
+		if (b->error || ++zeros > 31) {
+			b->error = 1;
+			return 0;
+		}
+	}
+
+	if (zeros == 0)
+		return 0;
+	return (1u << zeros) - 1 + bits_read(b, zeros);
+}
+
+int bits_read_se(struct bits *b)
+{
+	unsigned int v = bits_read_ue(b);
+
+	if (v & 1)
+		return (v + 1) / 2;
+	return -(int)(v / 2);
+}
+
+int h264_profile_has_chroma_format(unsigned int profile_idc)
+{
+	switch (profile_idc) {
+	case 44: case 83: case 86: case 100: case 110: case 118: case 122:
+	case 128: case 134: case 135: case 138: case 139: case 244:
+		return 1;
+	}
+	return 0;
+}
+
+void h264_skip_scaling_list(struct bits *b, int size)
+{
+	int last = 8, next = 8;
+	int n;
+
+	for (n = 0; n < size && !b->error; n++) {
+		if (next != 0) {
+			next = (last + bits_read_se(b) + 256) % 256;
+			if (next != 0)
+				last = next;
+		}
+	}
+}
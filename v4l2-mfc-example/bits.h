@@ -0,0 +1,60 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Bit reader header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_BITS_H
+#define INCLUDE_BITS_H
+
+/* Reader of the bit fields of stream headers. When the emulation prevention
+ * is enabled (H264) the 0x03 byte following two zero bytes is skipped and
+ * a start code prefix (00 00 0x, x < 3) ends the data. */
+struct bits {
+	const unsigned char *p;
+	const unsigned char *end;
+	/* Bits of the current byte that have not been read yet */
+	unsigned int cur;
+	int left;
+	/* Number of consecutive zero bytes read */
+	int zeros;
+	int emulation;
+	/* Set when reading past the end of the data */
+	int error;
+};
+
+/* Start reading size bytes at p */
+void		bits_init(struct bits *b, const char *p, int size,
+								int emulation);
+/* Read n bits (n <= 32), most significant first */
+unsigned int	bits_read(struct bits *b, int n);
+/* Read an unsigned Exp-Golomb code ue(v) */
+unsigned int	bits_read_ue(struct bits *b);
+/* Read a signed Exp-Golomb code se(v) */
+int		bits_read_se(struct bits *b);
+
+/* Helpers shared by the readers of the H264 sequence parameter set */
+
+/* Check if the SPS of the profile has chroma_format_idc and the fields
+ * that follow it */
+int		h264_profile_has_chroma_format(unsigned int profile_idc);
+/* Skip a scaling_list() of size coefficients */
+void		h264_skip_scaling_list(struct bits *b, int size);
+
+#endif /* INCLUDE_BITS_H */
@@ -0,0 +1,57 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Buffer ownership
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "buffers.h"
+#include "common.h"
+
+static const char *buf_state_name[] = { "free", "MFC", "FIMC", "display" };
+
+int buf_move(int *state, int from, int to)
+{
+	int old = from;
+
+	if (__atomic_compare_exchange_n(state, &old, to, 0, __ATOMIC_ACQ_REL,
+							__ATOMIC_ACQUIRE))
+		return 0;
+
+	err("Buffer owned by %s instead of %s", buf_state_name[old],
+							buf_state_name[from]);
+	return -1;
+}
+
+void buf_list_init(struct buf_list *l, int count)
+{
+	for (l->count = 0; l->count < count; l->count++)
+		l->e[l->count] = count - 1 - l->count;
+}
+
+int buf_list_get(struct buf_list *l)
+{
+	if (!l->count)
+		return -1;
+	return l->e[--l->count];
+}
+
+void buf_list_put(struct buf_list *l, int n)
+{
+	l->e[l->count++] = n;
+}
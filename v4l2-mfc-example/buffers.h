@@ -0,0 +1,47 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Buffer ownership header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef INCLUDE_BUFFERS_H
+#define INCLUDE_BUFFERS_H
+
+/* Maximum number of buffers in a free list, at least MFC_MAX_OUT_BUF */
+#define BUF_LIST_SIZE	32
+
+/* Free buffers of a queue. It is used only by the thread that queues and
+ * dequeues the buffers, so it is not locked. */
+struct buf_list {
+	int count;
+	int e[BUF_LIST_SIZE];
+};
+
+/* Move a buffer to a new owner with a compare and swap of its state (one
+ * of BUF_FREE, BUF_MFC, BUF_FIMC and BUF_DISPLAY). Returns -1 if the
+ * buffer is not in the expected state. */
+int	buf_move(int *state, int from, int to);
+/* Fill the list with buffers 0 to count - 1, buffer 0 is taken first */
+void	buf_list_init(struct buf_list *l, int count);
+/* Take a free buffer, -1 if there is none */
+int	buf_list_get(struct buf_list *l);
+/* Return a buffer to the list */
+void	buf_list_put(struct buf_list *l, int n);
+
+#endif /* INCLUDE_BUFFERS_H */
+
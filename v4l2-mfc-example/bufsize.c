@@ -0,0 +1,201 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Sizing of the OUTPUT buffers
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bufsize.h"
+#include "common.h"
+#include "fileops.h"
+#include "parser.h"
+
+#define KIB(x)	((int)(((x) + 1023) / 1024))
+
+static void stats_add(struct frame_stats *st, int size)
+{
+	st->frames++;
+	st->total += size;
+	if (size > st->max_size)
+		st->max_size = size;
+}
+
+static int stats_index(struct frame_index *idx, struct frame_stats *st)
+{
+	int n;
+
+	/* Entry 0 is the stream header */
+	for (n = 1; n < idx->count; n++)
+		stats_add(st, idx->e[n].size);
+	st->source = "frame index";
+
+	return 0;
+}
+
+static int stats_mp4(struct mp4_demux *m, struct frame_stats *st)
+{
+	const unsigned char *p = m->stsz + 12;
+	int size, n;
+
+	for (n = 0; n < m->sample_count; n++, p += 4) {
+		size = m->fixed_size ? m->fixed_size :
+				p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+		/* The length prefixes are replaced by 4 byte start codes,
+		 * a NAL unit has at least one byte */
+		if (m->length_size && m->length_size < 4)
+			size += size / (m->length_size + 1) *
+						(4 - m->length_size);
+		stats_add(st, size);
+	}
+	st->source = "MP4 sample tables";
+
+	return 0;
+}
+
+/* Run the parser over the beginning of the file in the span mode, with its
+ * own context */
+static int stats_scan(struct instance *i, struct frame_stats *st)
+{
+	struct mfc_parser_context ctx;
+	int size = BUFSIZE_SCAN_BYTES;
+	int used, fs, ret;
+	int offs = 0;
+	char *p;
+
+	if (size > i->in.size)
+		size = i->in.size;
+
+	p = input_ptr(i, 0, size);
+	if (!p)
+		return -1;
+
+	parse_stream_init(&ctx);
+	ret = i->parser.func(&ctx, p, size, NULL, INT_MAX, &used, &fs, 1);
+	if (ret == 0)
+		return -1;
+	offs += used;
+
+	while (st->frames < BUFSIZE_SCAN_FRAMES) {
+		ret = i->parser.func(&ctx, p + offs, size - offs, NULL,
+						INT_MAX, &used, &fs, 0);
+		/* Unless the whole file is scanned the last frame does not
+		 * end in the data */
+		if (ret == 0 && (offs == size || size < i->in.size ||
+								used == 0))
+			break;
+		stats_add(st, fs);
+		offs += used;
+	}
+	st->source = "beginning of the stream";
+	st->partial = size < i->in.size || st->frames == BUFSIZE_SCAN_FRAMES;
+
+	return st->frames ? 0 : -1;
+}
+
+int bufsize_stats(struct instance *i, struct frame_stats *st)
+{
+	memzero(*st);
+
+	if (i->index.loaded)
+		return stats_index(&i->index, st);
+	if (i->in.mp4.loaded)
+		return stats_mp4(&i->in.mp4, st);
+	if (!i->in.stream)
+		return stats_scan(i, st);
+
+	return -1;
+}
+
+void bufsize_choose(struct instance *i, int *size, int *count)
+{
+	struct frame_stats *st = &i->mfc.out_stats;
+	struct stream_probe *s = &i->parser.probe;
+	int limit = i->mfc.out_mem_limit;
+
+	if (!limit)
+		limit = BUFSIZE_MEM_LIMIT;
+
+	memzero(*st);
+	if (i->mfc.out_req_size) {
+		*size = i->mfc.out_req_size;
+	} else if (bufsize_stats(i, st) == 0) {
+		*size = st->max_size + st->max_size / 100 * BUFSIZE_HEADROOM;
+		/* The largest frame may come later in the stream, for
+		 * example at a scene cut */
+		if (st->partial && *size < BUFSIZE_DEFAULT_SIZE)
+			*size = BUFSIZE_DEFAULT_SIZE;
+	} else if (s->valid) {
+		/* Streamed input cannot be scanned ahead. A compressed frame
+		 * is assumed to be at most half of the decoded frame. */
+		*size = s->width * s->height * 3 / 4;
+	} else {
+		*size = BUFSIZE_DEFAULT_SIZE;
+	}
+
+	if (*size < BUFSIZE_MIN_SIZE)
+		*size = BUFSIZE_MIN_SIZE;
+	if (*size > BUFSIZE_MAX_SIZE && !i->mfc.out_req_size)
+		*size = BUFSIZE_MAX_SIZE;
+	/* Whole pages */
+	*size = (*size + 4095) & ~4095;
+
+	if (i->mfc.out_req_cnt) {
+		*count = i->mfc.out_req_cnt;
+	} else {
+		/* Small frames are queued more often, they get more buffers
+		 * for the same memory */
+		*count = limit / *size;
+		if (*count < BUFSIZE_MIN_CNT)
+			*count = BUFSIZE_MIN_CNT;
+		if (*count > BUFSIZE_MAX_CNT)
+			*count = BUFSIZE_MAX_CNT;
+	}
+
+	dbg("Chose %d OUTPUT buffers of %d bytes", *count, *size);
+}
+
+void bufsize_report(struct instance *i)
+{
+	struct frame_stats *st = &i->mfc.out_stats;
+	int out, cap;
+
+	if (i->mfc.out_memory == V4L2_MEMORY_USERPTR)
+		printf("OUTPUT buffers: %d queued from the input file\n",
+							i->mfc.out_buf_cnt);
+	else
+		printf("OUTPUT buffers: %d x %d KiB\n", i->mfc.out_buf_cnt,
+						KIB(i->mfc.out_buf_size));
+
+	if (st->frames)
+		printf("Frames: largest %d KiB, average %d KiB in %d frames "
+			"of the %s\n", KIB(st->max_size),
+			KIB(st->total / st->frames), st->frames, st->source);
+
+	out = 0;
+	if (i->mfc.out_memory != V4L2_MEMORY_USERPTR)
+		out = i->mfc.out_buf_cnt * KIB(i->mfc.out_buf_size);
+	cap = i->mfc.cap_buf_cnt * (KIB(i->mfc.cap_buf_size[0]) +
+					KIB(i->mfc.cap_buf_size[1]));
+	printf("MFC memory: %d KiB OUTPUT + %d x %d KiB CAPTURE = %d KiB\n",
+		out, i->mfc.cap_buf_cnt, KIB(i->mfc.cap_buf_size[0]) +
+		KIB(i->mfc.cap_buf_size[1]), out + cap);
+}
@@ -0,0 +1,67 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Sizing of the OUTPUT buffers header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_BUFSIZE_H
+#define INCLUDE_BUFSIZE_H
+
+#include <stdint.h>
+
+struct instance;
+
+/* Default policy for the OUTPUT (compressed stream) buffers. The largest
+ * frame gets the headroom on top of it, the number of buffers is what
+ * fits in the memory limit. */
+#define BUFSIZE_HEADROOM	25
+#define BUFSIZE_MIN_SIZE	(64 * 1024)
+#define BUFSIZE_MAX_SIZE	(8 * 1024 * 1024)
+#define BUFSIZE_DEFAULT_SIZE	(1024 * 1024)
+#define BUFSIZE_MEM_LIMIT	(6 * 1024 * 1024)
+#define BUFSIZE_MIN_CNT		2
+#define BUFSIZE_MAX_CNT		8
+
+/* The frames looked at when the stream has neither an index nor sample
+ * tables, whichever limit is reached first. A larger frame may follow, so
+ * the buffers are not made smaller than BUFSIZE_DEFAULT_SIZE then. */
+#define BUFSIZE_SCAN_BYTES	(8 * 1024 * 1024)
+#define BUFSIZE_SCAN_FRAMES	1000
+
+/* Sizes of the frames of the stream */
+struct frame_stats {
+	int frames;
+	int max_size;
+	uint64_t total;
+	/* Where the sizes have been taken from */
+	const char *source;
+	/* Set when only a part of the frames has been looked at */
+	int partial;
+};
+
+/* Collect the frame sizes from the frame index, the MP4 sample tables or
+ * a scan of the beginning of the file.
+ * Return value: 0 on success, -1 if no frames have been found */
+int	bufsize_stats(struct instance *i, struct frame_stats *st);
+/* Choose the size and the number of the OUTPUT buffers */
+void	bufsize_choose(struct instance *i, int *size, int *count);
+/* Print the memory used by the MFC buffers */
+void	bufsize_report(struct instance *i);
+
+#endif /* INCLUDE_BUFSIZE_H */
@@ -23,19 +23,32 @@
 #ifndef INCLUDE_COMMON_H
 #define INCLUDE_COMMON_H
 
+#include <linux/videodev2.h>
+#include <pthread.h>
 #include <stdio.h>
-#include <semaphore.h>
+#include <stdint.h>
 
+#include "buffers.h"
+#include "bufsize.h"
+#include "frame_ring.h"
+#include "index.h"
+#include "mp4.h"
 #include "parser.h"
+#include "probe.h"
 #include "queue.h"
+#include "stats.h"
+#include "ts.h"
 
 /* When ADD_DETAILS is defined every debug and error message contains
  * information about the file, function and line of code where it has
  * been called */
 #define ADD_DETAILS
 /* When DEBUG is defined debug messages are printed on the screen.
- * Otherwise only error messages are displayed. */
+ * Otherwise only error messages are displayed. Defining NO_DEBUG when
+ * compiling disables them, this is used by the benchmark. */
+#ifndef NO_DEBUG
 #define DEBUG
+#endif
 
 #ifdef ADD_DETAILS
 #define err(msg, ...) \
@@ -59,6 +72,20 @@
 #define dbg(...) {}
 #endif /* DEBUG */
 
+/* Formats missing in older kernel headers */
+#ifndef V4L2_PIX_FMT_HEVC
+#define V4L2_PIX_FMT_HEVC	v4l2_fourcc('H', 'E', 'V', 'C')
+#endif
+#ifndef V4L2_PIX_FMT_VC1_ANNEX_G
+#define V4L2_PIX_FMT_VC1_ANNEX_G v4l2_fourcc('V', 'C', '1', 'G')
+#endif
+#ifndef V4L2_PIX_FMT_VC1_ANNEX_L
+#define V4L2_PIX_FMT_VC1_ANNEX_L v4l2_fourcc('V', 'C', '1', 'L')
+#endif
+#ifndef V4L2_PIX_FMT_VP8
+#define V4L2_PIX_FMT_VP8	v4l2_fourcc('V', 'P', '8', '0')
+#endif
+
 #define memzero(x)\
         memset(&(x), 0, sizeof (x));
 
@@ -77,6 +104,9 @@
 /* Maximum number of frame buffers - used for double buffering and
  * vsyns synchronisation */
 #define FB_MAX_BUFS 2
+/* Maximum number of streams decoded at once, each uses an MFC context and
+ * MFC has 16 of them */
+#define MAX_STREAMS 16
 
 /* The buffer is free to use by MFC */
 #define BUF_FREE 0
@@ -85,6 +115,27 @@
 /* The buffer has been processed by MFC and is now queued
  * to be processed by FIMC. */
 #define BUF_FIMC 2
+/* The buffer is being converted by FIMC to the frame buffer */
+#define BUF_DISPLAY 3
+
+/* Windows of large input files: the parser and the thread queueing the
+ * frames each move their own one along the file */
+#define INPUT_WIN_PARSE	0
+#define INPUT_WIN_FRAME	1
+#define INPUT_WINDOWS	2
+
+/* Part of a large input file mapped to memory */
+struct input_window {
+	char *p;
+	/* Position of the mapped part in the file and its size */
+	uint64_t offs;
+	int size;
+	/* The pages before this position have been dropped */
+	uint64_t dropped;
+	/* The part of the file after the window is read ahead when the
+	 * parser reaches this position */
+	uint64_t ahead;
+};
 
 struct instance {
 	/* Input file related parameters */
@@ -92,8 +143,47 @@ struct instance {
 		char *name;
 		int fd;
 		char *p;
-		int size;
-		int offs;
+		uint64_t size;
+		uint64_t offs;
+
+		/* Files larger than INPUT_MAP_MAX are not mapped whole, but
+		 * through windows which slide along the file */
+		int windowed;
+		struct input_window win[INPUT_WINDOWS];
+
+		/* Streamed input (stdin, pipe, FIFO or a transport stream) is
+		 * read by a separate thread to a ring which is mapped twice,
+		 * back to back */
+		int stream;
+		int ring_size;
+		/* Positions in the stream: data before rd can be overwritten,
+		 * pos is where the parser continues and wr is where the
+		 * reader continues. The frames found so far end at done. */
+		unsigned long long rd;
+		unsigned long long pos;
+		unsigned long long wr;
+		unsigned long long done;
+		/* Set by the reader when the end of stream has been reached */
+		int eof;
+		/* Set on exit to stop waiting for the stream */
+		int stop;
+		pthread_t reader;
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+		/* Descriptor polled by the single threaded loop. The reader
+		 * signals it when more than notify bytes or the end of stream
+		 * are available, notify is -1 when no data is awaited. */
+		int event;
+		int notify;
+
+		/* Demultiplexer of transport streams and the PID chosen by
+		 * the user, 0 to use the first stream of the codec */
+		struct ts_demux ts;
+		int ts_pid;
+
+		/* Video track of an MP4 file, the frames are taken from its
+		 * sample tables */
+		struct mp4_demux mp4;
 	} in;
 
 	/* Frame buffer related parameters */
@@ -112,17 +202,39 @@ struct instance {
 		int size;
 		int full_size;
 		int double_buf;
+		/* Opened by another stream, which also closes it */
+		int shared;
 	} fb;
 
 	/* FIMC related parameter */
 	struct {
 		char *name;
 		int fd;
+		/* Decoded frames waiting for FIMC */
 		struct queue queue;
-		sem_t todo;
-		/* Semaphores are used to synchronise FIMC thread with
-		 * the MFC thread */
-		sem_t done;
+		/* CAPTURE buffers of MFC released by FIMC */
+		struct queue done;
+		/* Format of the OUTPUT queue, set up either from MFC or in
+		 * advance from the probed stream header */
+		int out_w;
+		int out_h;
+		int out_size[MFC_CAP_PLANES];
+		int out_cnt;
+		/* Memory type the OUTPUT buffers were requested with */
+		int out_req_memory;
+		/* Memory type used for the OUTPUT queue. With DMABUF the
+		 * CAPTURE buffers of MFC are imported, with USERPTR they are
+		 * passed through their mappings. */
+		int out_memory;
+		/* Set when streaming has been started on both queues */
+		int streaming;
+		/* Place of the stream in the mosaic of several streams on the
+		 * frame buffer and the number of places, 0 for full screen */
+		int tile;
+		int tiles;
+		/* CAPTURE buffer of MFC being converted in the single
+		 * threaded loop, -1 if none */
+		int job;
 	} fimc;
 
 	/* MFC related parameters */
@@ -131,11 +243,23 @@ struct instance {
 		int fd;
 
 		/* Output queue related */
+		/* Memory type used for the OUTPUT queue. With USERPTR the
+		 * frames are queued directly from the mmapped input file. */
+		int out_memory;
 		int out_buf_cnt;
 		int out_buf_size;
 		int out_buf_off[MFC_MAX_OUT_BUF];
 		char *out_buf_addr[MFC_MAX_OUT_BUF];
-		int out_buf_flag[MFC_MAX_OUT_BUF];
+		/* Owner of each buffer and the free ones */
+		int out_buf_state[MFC_MAX_OUT_BUF];
+		struct buf_list out_free;
+		/* Size and number of the OUTPUT buffers requested by the user
+		 * and the memory limit for them, 0 to choose them from the
+		 * frame sizes of the stream */
+		int out_req_size;
+		int out_req_cnt;
+		int out_mem_limit;
+		struct frame_stats out_stats;
 
 		/* Capture queue related */
 		int cap_w;
@@ -149,7 +273,12 @@ struct instance {
 		int cap_buf_size[MFC_CAP_PLANES];
 		int cap_buf_off[MFC_MAX_CAP_BUF][MFC_CAP_PLANES];
 		char *cap_buf_addr[MFC_MAX_CAP_BUF][MFC_CAP_PLANES];
-		int cap_buf_flag[MFC_MAX_CAP_BUF];
+		/* DMABUF descriptors of the planes and the number of the
+		 * buffers exported, when FIMC imports them */
+		int cap_buf_fd[MFC_MAX_CAP_BUF][MFC_CAP_PLANES];
+		int cap_buf_exported;
+		/* Owner of each buffer, the free ones are in fimc.done */
+		int cap_buf_state[MFC_MAX_CAP_BUF];
 		int cap_buf_queued;
 	} mfc;
 
@@ -165,10 +294,32 @@ struct instance {
 		/* Set when the parser has finished and end of file has
 		 * been reached */
 		int finished;
+		/* Number of the frame to start decoding from. Requires
+		 * the frame index. */
+		int seek;
+		/* Resolution read from the stream header by the CPU */
+		struct stream_probe probe;
+		/* Frames found by the parse ahead thread that wait to be
+		 * queued */
+		struct frame_ring ahead;
+		/* Statistics of the stream, collected when a file name is
+		 * given for them */
+		char *stats_name;
+		struct parser_stats stats;
 	} parser;
 
+	/* Frame index of the stream */
+	struct frame_index index;
+
+
+	/* Number of the frames shown and the times when decoding started
+	 * and the last frame was shown, in ms */
+	int frames;
+	double start;
+	double end;
 
 	/* Control */
+	int event_loop; /* Decode in one thread that waits in poll() */
 	int error; /* The error flag */
 	int finish;  /* Flag set when decoding has been completed and all
 			threads finish */
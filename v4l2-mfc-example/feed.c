@@ -0,0 +1,293 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Chunked stream parser
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+
+#include "common.h"
+#include "feed.h"
+#include "parser.h"
+
+/* Initial number of chunk and span entries */
+#define FEED_ALLOC_STEP		64
+
+int feed_init(struct feed *f, feed_parser func, unsigned long codec)
+{
+	memzero(*f);
+	parse_stream_init(&f->ctx);
+	f->func = func;
+	f->codec = codec;
+	return 0;
+}
+
+int feed_push(struct feed *f, const char *p, int size)
+{
+	struct feed_chunk *c;
+	int alloc;
+
+	if (size <= 0)
+		return 0;
+
+	if (f->count == f->alloc && f->first) {
+		/* Reuse the entries of the released chunks */
+		memmove(f->chunks, f->chunks + f->first,
+				(f->count - f->first) * sizeof(*f->chunks));
+		f->count -= f->first;
+		f->cur -= f->first;
+		if (f->cur < 0)
+			f->cur = 0;
+		f->first = 0;
+	}
+
+	if (f->count == f->alloc) {
+		alloc = f->alloc ? 2 * f->alloc : FEED_ALLOC_STEP;
+		c = realloc(f->chunks, alloc * sizeof(*c));
+		if (!c) {
+			err("Failed to grow the list of chunks");
+			return -1;
+		}
+		f->chunks = c;
+		f->alloc = alloc;
+	}
+
+	c = &f->chunks[f->count++];
+	c->p = p;
+	c->size = size;
+	c->offs = f->end;
+	f->end += size;
+
+	return 0;
+}
+
+void feed_end(struct feed *f)
+{
+	f->eof = 1;
+}
+
+/* Find the chunk that contains the given position of the stream, starting
+ * from chunk n */
+static int feed_find(struct feed *f, uint64_t offs, int n)
+{
+	if (n < f->first)
+		n = f->first;
+	while (n > f->first && f->chunks[n].offs > offs)
+		n--;
+	while (n < f->count - 1 &&
+			f->chunks[n].offs + f->chunks[n].size <= offs)
+		n++;
+	return n;
+}
+
+/* Copy size bytes of the stream from offs, which is in chunk n */
+static void feed_copy(struct feed *f, int n, uint64_t offs, char *dst,
+								int size)
+{
+	struct feed_chunk *c;
+	int skip, len;
+
+	while (size > 0) {
+		c = &f->chunks[n++];
+		skip = offs - c->offs;
+		len = c->size - skip;
+		if (len > size)
+			len = size;
+		memcpy(dst, c->p + skip, len);
+		dst += len;
+		offs += len;
+		size -= len;
+	}
+}
+
+/* Describe the frame with the spans of the chunks it lies in */
+static int feed_spans(struct feed *f, struct feed_frame *fr)
+{
+	struct feed_chunk *c;
+	struct feed_span *s;
+	uint64_t offs = fr->offs;
+	int left = fr->size;
+	int n, skip, alloc;
+
+	if (f->first == f->count || offs < f->chunks[f->first].offs) {
+		err("The frame begins in a released chunk");
+		return -1;
+	}
+
+	fr->count = 0;
+	n = feed_find(f, offs, f->cur);
+	while (left > 0) {
+		if (fr->count == f->span_alloc) {
+			alloc = f->span_alloc ? 2 * f->span_alloc :
+							FEED_ALLOC_STEP;
+			s = realloc(f->span, alloc * sizeof(*s));
+			if (!s) {
+				err("Failed to grow the list of frame spans");
+				return -1;
+			}
+			f->span = s;
+			f->span_alloc = alloc;
+		}
+		c = &f->chunks[n++];
+		skip = offs - c->offs;
+		s = &f->span[fr->count++];
+		s->p = c->p + skip;
+		s->size = c->size - skip;
+		if (s->size > left)
+			s->size = left;
+		offs += s->size;
+		left -= s->size;
+	}
+	fr->span = f->span;
+
+	return 0;
+}
+
+/* The data is parsed in place where it is possible. The parser has to see
+ * FEED_LOOKAHEAD bytes after the data it consumes, so near the end of a
+ * chunk the data is copied together with the beginning of the following
+ * chunks and parsed from the copy. */
+int feed_next(struct feed *f, struct feed_frame *fr, int get_head)
+{
+	struct feed_chunk *c;
+	uint64_t avail, base;
+	int in_size, look, rest, n;
+	int used, fs, ret;
+	char *in;
+
+	if (f->done)
+		return 0;
+
+	while (1) {
+		avail = f->end - f->pos;
+		if (!f->eof && (avail <= FEED_LOOKAHEAD || f->end < f->retry))
+			return 0;
+		if (avail == 0) {
+			f->done = 1;
+			return 0;
+		}
+
+		/* At the end of the stream the rest is parsed at once */
+		if (f->eof && avail <= FEED_LOOKAHEAD) {
+			look = 0;
+			in_size = avail;
+		} else {
+			look = FEED_LOOKAHEAD;
+			in_size = avail - look > INT_MAX / 2 ?
+						INT_MAX / 2 : avail - look;
+		}
+
+		f->cur = feed_find(f, f->pos, f->cur);
+		c = &f->chunks[f->cur];
+		rest = c->offs + c->size - f->pos;
+		if (rest >= in_size + look || (look && rest > look)) {
+			in = (char *)c->p + (f->pos - c->offs);
+			if (rest - look < in_size)
+				in_size = rest - look;
+		} else {
+			/* Wait until the copy can be parsed as far as the
+			 * lookahead, so small chunks are not copied many
+			 * times */
+			if (!f->eof && avail < sizeof(f->bridge))
+				return 0;
+			n = avail < sizeof(f->bridge) ? avail :
+							sizeof(f->bridge);
+			feed_copy(f, f->cur, f->pos, f->bridge, n);
+			in = f->bridge;
+			if (in_size > n - look)
+				in_size = n - look;
+		}
+
+		f->ctx.lookahead = look;
+		f->ctx.avail = avail > INT_MAX ? INT_MAX : avail;
+		base = f->pos;
+		ret = f->func(&f->ctx, in, in_size, NULL, INT_MAX, &used, &fs,
+								get_head);
+		f->pos += used;
+
+		if (ret == 1)
+			break;
+
+		if (f->eof && f->pos == f->end) {
+			/* The last frame ends with the stream */
+			f->done = 1;
+			if (fs == 0 || get_head)
+				return 0;
+			break;
+		}
+
+		/* The frame of an RCV or IVF file has not been read
+		 * completely. The parser waits until the data available
+		 * doubles, so large frames passed in small chunks are not
+		 * looked at again with every chunk. */
+		if (used == 0) {
+			if (f->eof)
+				f->done = 1;
+			f->retry = f->end + avail;
+			return 0;
+		}
+	}
+
+	fr->offs = base + f->ctx.frame_offs;
+	fr->size = fs;
+	fr->flags = f->ctx.frame_flags;
+	fr->type = f->ctx.frame_type;
+	fr->coding = f->ctx.frame_coding;
+
+	if (get_head && (f->codec == V4L2_PIX_FMT_H263 ||
+					f->codec == V4L2_PIX_FMT_VP8)) {
+		/* The header is the first frame, which is returned again */
+		parse_stream_init(&f->ctx);
+		f->pos = f->keep;
+		f->done = 0;
+	} else {
+		f->keep = fr->offs + fr->size;
+	}
+
+	return feed_spans(f, fr) ? -1 : 1;
+}
+
+int feed_release(struct feed *f, uint64_t offs)
+{
+	struct feed_chunk *c;
+	int n = 0;
+
+	if (offs > f->keep)
+		offs = f->keep;
+
+	while (f->first < f->count) {
+		c = &f->chunks[f->first];
+		if (c->offs + c->size > offs)
+			break;
+		f->first++;
+		n++;
+	}
+
+	return n;
+}
+
+void feed_free(struct feed *f)
+{
+	free(f->chunks);
+	free(f->span);
+	memzero(*f);
+}
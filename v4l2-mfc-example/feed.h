@@ -0,0 +1,116 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Chunked stream parser
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_FEED_H
+#define INCLUDE_FEED_H
+
+#include <stdint.h>
+
+#include "parser.h"
+
+/* Number of bytes the parser may have to look at after a start code to
+ * classify the unit (the longest are H264 sequence parameter sets with
+ * scaling lists). The parser is run this far behind the end of the data
+ * fed so far. */
+#define FEED_LOOKAHEAD		1024
+
+typedef int (*feed_parser)(struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head);
+
+/* Piece of the stream passed to feed_push */
+struct feed_chunk {
+	const char *p;
+	int size;
+	/* Position of the chunk in the stream */
+	uint64_t offs;
+};
+
+/* Part of a frame that lies in one chunk */
+struct feed_span {
+	const char *p;
+	int size;
+};
+
+/* Frame found by feed_next. The spans point to the memory of the chunks
+ * and are valid until the next call of feed_next. */
+struct feed_frame {
+	uint64_t offs;
+	int size;
+	int flags;
+	int type;
+	int coding;
+	struct feed_span *span;
+	int count;
+};
+
+/* Parser of a stream that is passed in chunks of any size. The chunks
+ * are not copied, except for a few bytes around the boundaries of small
+ * chunks, and stay in use until they are released. */
+struct feed {
+	struct mfc_parser_context ctx;
+	feed_parser func;
+	unsigned long codec;
+	/* Chunks that have not been released, from first to count - 1.
+	 * cur is the chunk where the parser continues. */
+	struct feed_chunk *chunks;
+	int first;
+	int cur;
+	int count;
+	int alloc;
+	/* Position of the parser in the stream and the end of the data */
+	uint64_t pos;
+	uint64_t end;
+	/* The data from keep on is still used: the next frame begins there */
+	uint64_t keep;
+	/* The parser is run again when the end of the data reaches retry */
+	uint64_t retry;
+	/* Set by feed_end */
+	int eof;
+	/* Set after the last frame has been returned */
+	int done;
+	/* The data around the boundary of chunks is parsed from a copy */
+	char bridge[2 * FEED_LOOKAHEAD];
+	struct feed_span *span;
+	int span_alloc;
+};
+
+/* Initialise the chunked parser */
+int	feed_init(struct feed *f, feed_parser func, unsigned long codec);
+/* Append a chunk to the stream. Its memory has to stay valid until the
+ * chunk is released.
+ * Return value: 0 on success, -1 on error */
+int	feed_push(struct feed *f, const char *p, int size);
+/* Mark the end of the stream, the last frame ends with it */
+void	feed_end(struct feed *f);
+/* Find the next frame, with get_head the stream header.
+ * Return value: 1 if a frame has been found, 0 if more data is needed or
+ * the stream has ended, -1 on error */
+int	feed_next(struct feed *f, struct feed_frame *fr, int get_head);
+/* Release the chunks that end before offs, they are no longer used. The
+ * data of the next frame is kept anyway.
+ * Return value: the number of chunks released, oldest first */
+int	feed_release(struct feed *f, uint64_t offs);
+/* Free the memory of the chunked parser */
+void	feed_free(struct feed *f);
+
+#endif /* INCLUDE_FEED_H */
@@ -20,38 +20,662 @@
  *
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/videodev2.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "common.h"
 #include "fileops.h"
+#include "mp4.h"
+#include "ts.h"
+
+/* Size of the ring used for streamed input. It has to be larger than
+ * the largest compressed frame. */
+#define INPUT_RING_SIZE		(4 * 1024 * 1024)
+/* Size of the chunks in which a transport stream is read */
+#define INPUT_TS_READ_SIZE	(512 * 192)
+/* Files up to this size are mapped whole. Larger files are mapped through
+ * windows, so the address space and memory used do not grow with them. */
+#define INPUT_MAP_MAX		(256 * 1024 * 1024)
+/* Size of the windows. It has to be larger than the largest compressed
+ * frame, otherwise the window grows to fit the frame. */
+#define INPUT_WINDOW_SIZE	(32 * 1024 * 1024)
+/* The pages a window has passed are dropped in steps of this size */
+#define INPUT_DROP_STEP		(1024 * 1024)
+
+/* Create the backing file of the ring */
+static int ring_file(int size)
+{
+	char name[] = "/tmp/v4l2_decode-XXXXXX";
+	int fd;
+
+#ifdef SYS_memfd_create
+	fd = syscall(SYS_memfd_create, "v4l2_decode", 0);
+	if (fd < 0)
+#endif
+	{
+		fd = mkstemp(name);
+		if (fd >= 0)
+			unlink(name);
+	}
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* The ring is mapped twice, one mapping right after the other. This way
+ * any size bytes of the ring, starting at any position, are contiguous
+ * in memory and the parsers can work on them directly. */
+static char *ring_map(int size)
+{
+	char *p;
+	int fd;
+
+	fd = ring_file(size);
+	if (fd < 0)
+		return MAP_FAILED;
+
+	p = mmap(0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		close(fd);
+		return MAP_FAILED;
+	}
+
+	if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+						fd, 0) == MAP_FAILED ||
+		mmap(p + size, size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(p, 2 * size);
+		close(fd);
+		return MAP_FAILED;
+	}
+
+	close(fd);
+	return p;
+}
+
+/* Read from the input, retrying when interrupted */
+static int input_read(struct instance *i, char *p, int len)
+{
+	int ret;
+
+	do {
+		ret = read(i->in.fd, p, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		err("Failed to read the input stream");
+	return ret;
+}
+
+/* Wake up the parser waiting for data. The lock has to be held. */
+static void input_signal(struct instance *i)
+{
+	pthread_cond_broadcast(&i->in.cond);
+	if (i->in.event && i->in.notify >= 0 && (i->in.eof ||
+			(int)(i->in.wr - i->in.pos) > i->in.notify))
+		eventfd_write(i->in.event, 1);
+}
+
+/* Copy data to the ring, waiting for the space to be released */
+static void ring_write(void *priv, const char *p, int len)
+{
+	struct instance *i = (struct instance *)priv;
+	int space;
+
+	while (len > 0) {
+		pthread_mutex_lock(&i->in.lock);
+		while ((space = i->in.ring_size - (int)(i->in.wr - i->in.rd)) == 0)
+			pthread_cond_wait(&i->in.cond, &i->in.lock);
+		pthread_mutex_unlock(&i->in.lock);
+
+		if (space > len)
+			space = len;
+		memcpy(i->in.p + i->in.wr % i->in.ring_size, p, space);
+		p += space;
+		len -= space;
+
+		pthread_mutex_lock(&i->in.lock);
+		i->in.wr += space;
+		input_signal(i);
+		pthread_mutex_unlock(&i->in.lock);
+	}
+}
+
+/* Read the elementary stream straight to the ring as long as there is
+ * free space in it */
+static void input_read_plain(struct instance *i)
+{
+	int space;
+	int ret;
+
+	while (1) {
+		pthread_mutex_lock(&i->in.lock);
+		while ((space = i->in.ring_size - (int)(i->in.wr - i->in.rd)) == 0)
+			pthread_cond_wait(&i->in.cond, &i->in.lock);
+		pthread_mutex_unlock(&i->in.lock);
+
+		ret = input_read(i, i->in.p + i->in.wr % i->in.ring_size, space);
+		if (ret <= 0)
+			return;
+
+		pthread_mutex_lock(&i->in.lock);
+		i->in.wr += ret;
+		input_signal(i);
+		pthread_mutex_unlock(&i->in.lock);
+	}
+}
+
+/* Demultiplex the transport stream, the payload of the chosen elementary
+ * stream is copied to the ring */
+static void input_read_ts(struct instance *i, char *probe, int len,
+							int packet_size)
+{
+	char *buf;
+	int used;
+	int ret;
+
+	dbg("Demultiplexing a transport stream with %d byte packets",
+								packet_size);
+	ts_init(&i->in.ts, i->parser.codec, i->in.ts_pid, packet_size);
+
+	buf = malloc(INPUT_TS_READ_SIZE);
+	if (!buf) {
+		err("Failed to allocate the transport stream buffer");
+		return;
+	}
+	pthread_cleanup_push(free, buf);
+
+	memcpy(buf, probe, len);
+	while (1) {
+		used = ts_demux(&i->in.ts, buf, len, ring_write, i);
+		len -= used;
+		memmove(buf, buf + used, len);
+
+		ret = input_read(i, buf + len, INPUT_TS_READ_SIZE - len);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+
+	if (i->in.ts.errors)
+		dbg("Found %d errors in the transport stream", i->in.ts.errors);
+
+	pthread_cleanup_pop(1);
+}
+
+/* This thread reads the streamed input into the ring. The format of the
+ * input is detected from its beginning. */
+static void *input_reader_func(void *args)
+{
+	struct instance *i = (struct instance *)args;
+	char probe[TS_PROBE_SIZE];
+	int len = 0;
+	int ret;
+
+	while (len < TS_PROBE_SIZE) {
+		ret = input_read(i, probe + len, TS_PROBE_SIZE - len);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+
+	ret = ts_probe(probe, len);
+	if (ret) {
+		input_read_ts(i, probe, len, ret);
+	} else {
+		ring_write(i, probe, len);
+		input_read_plain(i);
+	}
+
+	pthread_mutex_lock(&i->in.lock);
+	i->in.eof = 1;
+	input_signal(i);
+	pthread_mutex_unlock(&i->in.lock);
+
+	dbg("Input reader thread finished");
+	return 0;
+}
+
+static int input_open_stream(struct instance *i)
+{
+	i->in.stream = 1;
+	i->in.ring_size = INPUT_RING_SIZE;
+	i->in.rd = 0;
+	i->in.pos = 0;
+	i->in.wr = 0;
+	i->in.done = 0;
+	i->in.eof = 0;
+	i->in.stop = 0;
+	i->in.event = 0;
+	i->in.notify = -1;
+
+	i->in.p = ring_map(i->in.ring_size);
+	if (i->in.p == MAP_FAILED) {
+		i->in.p = NULL;
+		err("Failed to create the input ring");
+		return -1;
+	}
+
+	/* The frames have to be copied before the ring space is reused */
+	if (i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		dbg("USERPTR cannot be used with streamed input, using MMAP");
+		i->mfc.out_memory = V4L2_MEMORY_MMAP;
+	}
+
+	pthread_mutex_init(&i->in.lock, NULL);
+	pthread_cond_init(&i->in.cond, NULL);
+
+	if (pthread_create(&i->in.reader, NULL, input_reader_func, i)) {
+		err("Failed to start the input reader thread");
+		munmap(i->in.p, 2 * i->in.ring_size);
+		i->in.p = NULL;
+		return -1;
+	}
+
+	dbg("Reading streamed input through a %d byte ring", i->in.ring_size);
+
+	return 0;
+}
+
+static void window_unmap(struct input_window *w)
+{
+	if (w->p)
+		munmap(w->p, w->size);
+	w->p = NULL;
+}
+
+/* Map the part of the file with at least size bytes from offs on to the
+ * window. The window starts at the page containing offs and is read ahead
+ * sequentially. */
+static int window_map(struct instance *i, struct input_window *w,
+						uint64_t offs, int size)
+{
+	uint64_t start = offs & ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+	uint64_t len = INPUT_WINDOW_SIZE;
+	char *p;
+
+	if (len < offs - start + size)
+		len = offs - start + size;
+	if (len > i->in.size - start)
+		len = i->in.size - start;
+
+	window_unmap(w);
+	p = mmap(0, len, PROT_READ, MAP_SHARED, i->in.fd, start);
+	if (p == MAP_FAILED) {
+		err("Failed to map the input file at offset %llu",
+						(unsigned long long)start);
+		return -1;
+	}
+	madvise(p, len, MADV_SEQUENTIAL);
+	madvise(p, len, MADV_WILLNEED);
+
+	w->p = p;
+	w->offs = start;
+	w->size = len;
+	w->dropped = start;
+	w->ahead = start + len / 2;
+
+	return 0;
+}
+
+/* Drop the pages of the window before offs, they are not used again. With
+ * evict they are dropped from the page cache too. */
+static void window_drop(struct instance *i, struct input_window *w,
+						uint64_t offs, int evict)
+{
+	uint64_t end = offs & ~(uint64_t)(INPUT_DROP_STEP - 1);
+
+	if (end > w->offs + w->size)
+		end = w->offs + w->size;
+	if (!w->p || end < w->dropped + INPUT_DROP_STEP)
+		return;
+
+	madvise(w->p + (w->dropped - w->offs), end - w->dropped,
+							MADV_DONTNEED);
+	if (evict)
+		posix_fadvise(i->in.fd, w->dropped, end - w->dropped,
+							POSIX_FADV_DONTNEED);
+	w->dropped = end;
+}
+
+/* Open a large file through windows. Transport streams are read to the
+ * ring as usual and MP4 files still have to be mapped whole, their sample
+ * tables are used in place.
+ * Return value: 0 on success, 1 if the file has to be mapped whole, -1 on
+ * error */
+static int input_open_windowed(struct instance *i)
+{
+	struct input_window *w = &i->in.win[INPUT_WIN_PARSE];
+
+	if (window_map(i, w, 0, 0))
+		return -1;
+
+	if (ts_probe(w->p, w->size)) {
+		window_unmap(w);
+		return input_open_stream(i);
+	}
+
+	if (mp4_probe(w->p, w->size)) {
+		window_unmap(w);
+		return 1;
+	}
+
+	/* The frames have to be copied before the windows move on */
+	if (i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		dbg("USERPTR cannot be used with large files, using MMAP");
+		i->mfc.out_memory = V4L2_MEMORY_MMAP;
+	}
+
+	i->in.windowed = 1;
+	dbg("Mapping the %llu byte input file through %d byte windows",
+			(unsigned long long)i->in.size, INPUT_WINDOW_SIZE);
+
+	return 0;
+}
 
 int input_open(struct instance *i, char *name)
 {
 	struct stat in_stat;
+	int ret;
 
-	i->in.fd = open(name, O_RDONLY);
-	if (!i->in.fd) {
+	if (strcmp(name, "-") == 0)
+		i->in.fd = dup(STDIN_FILENO);
+	else
+		i->in.fd = open(name, O_RDONLY);
+	if (i->in.fd < 0) {
 		err("Failed to open file: %s", i->in.name);
 		return -1;
 	}
 	fstat(i->in.fd, &in_stat);
+
+	/* Pipes, FIFOs and the like cannot be mapped, transport streams are
+	 * demultiplexed to the ring as well */
+	if (!S_ISREG(in_stat.st_mode))
+		return input_open_stream(i);
+
 	i->in.size = in_stat.st_size;
 	i->in.offs = 0;
+
+	if (i->in.size > INPUT_MAP_MAX) {
+		ret = input_open_windowed(i);
+		if (ret <= 0)
+			return ret;
+	}
+
+	if (i->in.size != (size_t)i->in.size) {
+		err("Input file too large to be mapped");
+		return -1;
+	}
 	i->in.p = mmap(0, i->in.size, PROT_READ, MAP_SHARED, i->in.fd, 0);
 	if (i->in.p == MAP_FAILED) {
+		i->in.p = NULL;
 		err("Failed to map input file");
 		return -1;
 	}
+
+	if (ts_probe(i->in.p, i->in.size)) {
+		munmap(i->in.p, i->in.size);
+		i->in.p = NULL;
+		return input_open_stream(i);
+	}
+
+	if (mp4_probe(i->in.p, i->in.size)) {
+		if (mp4_open(&i->in.mp4, i->in.p, i->in.size, i->parser.codec))
+			return -1;
+		/* The length prefixes are replaced while copying */
+		if (i->in.mp4.length_size &&
+			i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+			dbg("USERPTR cannot be used with this MP4 file, using MMAP");
+			i->mfc.out_memory = V4L2_MEMORY_MMAP;
+		}
+	}
+
 	return 0;
 }
 
+char *input_data(struct instance *i, int want, int *len, int *eof)
+{
+	struct input_window *w = &i->in.win[INPUT_WIN_PARSE];
+	uint64_t end;
+	char *p;
+
+	if (i->in.windowed) {
+		end = w->offs + w->size;
+		if (end - i->in.offs <= want && end < i->in.size) {
+			if (window_map(i, w, i->in.offs, want + 1))
+				return NULL;
+			end = w->offs + w->size;
+		}
+		*len = end - i->in.offs;
+		*eof = end == i->in.size;
+		return w->p + (i->in.offs - w->offs);
+	}
+
+	if (!i->in.stream) {
+		*len = i->in.size - i->in.offs;
+		*eof = 1;
+		return i->in.p + i->in.offs;
+	}
+
+	pthread_mutex_lock(&i->in.lock);
+	while (!i->in.eof && !i->in.stop &&
+				(int)(i->in.wr - i->in.pos) <= want)
+		pthread_cond_wait(&i->in.cond, &i->in.lock);
+
+	*len = i->in.wr - i->in.pos;
+	*eof = i->in.eof || i->in.stop;
+	/* All the data between rd and wr is contiguous in the mapping that
+	 * starts at rd */
+	p = i->in.p + i->in.rd % i->in.ring_size + (int)(i->in.pos - i->in.rd);
+	pthread_mutex_unlock(&i->in.lock);
+
+	return p;
+}
+
+int input_poll_fd(struct instance *i)
+{
+	int fd;
+
+	if (!i->in.stream)
+		return 0;
+	if (i->in.event)
+		return i->in.event;
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0) {
+		err("Failed to create the input event");
+		return -1;
+	}
+
+	pthread_mutex_lock(&i->in.lock);
+	i->in.event = fd;
+	pthread_mutex_unlock(&i->in.lock);
+
+	return fd;
+}
+
+int input_ready(struct instance *i, int want)
+{
+	int ready;
+
+	if (!i->in.stream)
+		return 1;
+
+	pthread_mutex_lock(&i->in.lock);
+	/* The data awaited before has to arrive first, until then the
+	 * frame is not parsed again */
+	if (want < i->in.notify)
+		want = i->in.notify;
+	ready = i->in.eof || i->in.stop ||
+				(int)(i->in.wr - i->in.pos) > want;
+	i->in.notify = ready ? -1 : want;
+	/* The reader signals only while data is awaited */
+	if (ready && i->in.event)
+		eventfd_read(i->in.event, &(eventfd_t){0});
+	pthread_mutex_unlock(&i->in.lock);
+
+	return ready;
+}
+
+int input_space(struct instance *i)
+{
+	int space;
+
+	/* The window grows to fit the frame, up to the end of the file */
+	if (i->in.windowed) {
+		if (i->in.size - i->in.offs > INT_MAX / 2)
+			return INT_MAX / 2;
+		return i->in.size - i->in.offs;
+	}
+	if (!i->in.stream)
+		return i->in.size - i->in.offs;
+
+	pthread_mutex_lock(&i->in.lock);
+	space = i->in.ring_size - (int)(i->in.pos - i->in.rd);
+	pthread_mutex_unlock(&i->in.lock);
+
+	return space;
+}
+
+uint64_t input_tell(struct instance *i)
+{
+	if (!i->in.stream)
+		return i->in.offs;
+
+	return i->in.pos;
+}
+
+char *input_ptr(struct instance *i, uint64_t offs, int size)
+{
+	struct input_window *w = &i->in.win[INPUT_WIN_FRAME];
+
+	if (i->in.windowed) {
+		/* An empty frame may point anywhere */
+		if ((!w->p || (size && (offs < w->offs ||
+				offs + size > w->offs + w->size))) &&
+				window_map(i, w, offs, size))
+			return NULL;
+		return size ? w->p + (offs - w->offs) : w->p;
+	}
+
+	if (!i->in.stream)
+		return i->in.p + offs;
+
+	return i->in.p + offs % i->in.ring_size;
+}
+
+void input_advance(struct instance *i, int used, int end)
+{
+	struct input_window *w = &i->in.win[INPUT_WIN_PARSE];
+
+	if (i->in.windowed) {
+		i->in.offs += used;
+		window_drop(i, w, i->in.offs, 0);
+		/* Start reading the part after the window before the parser
+		 * gets there */
+		if (i->in.offs >= w->ahead) {
+			posix_fadvise(i->in.fd, w->offs + w->size,
+				INPUT_WINDOW_SIZE, POSIX_FADV_WILLNEED);
+			w->ahead = w->offs + w->size;
+		}
+		return;
+	}
+
+	if (!i->in.stream) {
+		i->in.offs += used;
+		return;
+	}
+
+	pthread_mutex_lock(&i->in.lock);
+	i->in.done = i->in.pos + end;
+	i->in.pos += used;
+	pthread_mutex_unlock(&i->in.lock);
+}
+
+void input_release(struct instance *i, uint64_t offs)
+{
+	/* The frames are read once, keep them out of the page cache too */
+	if (i->in.windowed)
+		window_drop(i, &i->in.win[INPUT_WIN_FRAME], offs, 1);
+	if (!i->in.stream)
+		return;
+
+	pthread_mutex_lock(&i->in.lock);
+	/* The parser may still need the data after its position */
+	if (offs > i->in.pos)
+		offs = i->in.pos;
+	if (offs > i->in.rd) {
+		i->in.rd = offs;
+		pthread_cond_broadcast(&i->in.cond);
+	}
+	pthread_mutex_unlock(&i->in.lock);
+}
+
+int input_wait_release(struct instance *i)
+{
+	unsigned long long rd;
+	int ret;
+
+	if (!i->in.stream)
+		return -1;
+
+	pthread_mutex_lock(&i->in.lock);
+	rd = i->in.rd;
+	while (i->in.rd == rd && i->in.rd < i->in.done && !i->in.stop)
+		pthread_cond_wait(&i->in.cond, &i->in.lock);
+	ret = i->in.rd == rd ? -1 : 0;
+	pthread_mutex_unlock(&i->in.lock);
+
+	return ret;
+}
+
+void input_stop(struct instance *i)
+{
+	if (!i->in.stream)
+		return;
+
+	pthread_mutex_lock(&i->in.lock);
+	i->in.stop = 1;
+	pthread_cond_broadcast(&i->in.cond);
+	pthread_mutex_unlock(&i->in.lock);
+}
+
 void input_close(struct instance *i)
 {
-	munmap(i->in.p, i->in.size);
+	int n;
+
+	if (i->in.stream) {
+		/* The reader may be blocked in read() on a stream that
+		 * never ends */
+		pthread_cancel(i->in.reader);
+		pthread_join(i->in.reader, NULL);
+		if (i->in.p)
+			munmap(i->in.p, 2 * i->in.ring_size);
+		if (i->in.event)
+			close(i->in.event);
+	} else if (i->in.windowed) {
+		for (n = 0; n < INPUT_WINDOWS; n++)
+			window_unmap(&i->in.win[n]);
+	} else if (i->in.p) {
+		mp4_close(&i->in.mp4);
+		munmap(i->in.p, i->in.size);
+	}
 	close(i->in.fd);
 }
-
@@ -25,8 +25,46 @@
 
 #include "common.h"
 
-/* Open and mmap the input file */
+/* Open and mmap the input file. If name is "-", the file cannot be
+ * mmapped (pipe, FIFO) or it is a transport stream then it is read to a
+ * ring by a separate thread. Large files are mapped through windows. The
+ * video track of an MP4 file is found. */
 int	input_open(struct instance *i, char *name);
+/* Get the input data starting at the current position. For streamed input
+ * wait until more than want bytes or the end of stream are available, the
+ * window of a large file is moved to make them available. The number of
+ * available bytes is returned in len and eof is set when there is no more
+ * data to come. Returns NULL on error. */
+char	*input_data(struct instance *i, int want, int *len, int *eof);
+/* Descriptor that becomes readable when the data waited for with
+ * input_ready() is available. From then on the parser does not wait for
+ * the streamed input. Returns 0 if the input is not streamed, -1 on
+ * error. */
+int	input_poll_fd(struct instance *i);
+/* Check without waiting if more than want bytes or the end of stream are
+ * available. If not, the descriptor of input_poll_fd() is signalled when
+ * they are. */
+int	input_ready(struct instance *i, int want);
+/* Number of bytes that can be available at once at the current position */
+int	input_space(struct instance *i);
+/* Current position in the stream */
+uint64_t input_tell(struct instance *i);
+/* Pointer to the size bytes at the position offs in the stream. With
+ * streamed input the data has to be still in the ring. Large files are
+ * mapped through a window of the thread queueing the frames, the pointer
+ * is valid until the next call. Returns NULL on error. */
+char	*input_ptr(struct instance *i, uint64_t offs, int size);
+/* Move the current position by used bytes. The frame that has been found
+ * ends end bytes after the old position. */
+void	input_advance(struct instance *i, int used, int end);
+/* Let the reader overwrite the data before the position offs, it is
+ * called when the frames before it have been queued */
+void	input_release(struct instance *i, uint64_t offs);
+/* Wait until some of the ring is released by queueing the frames found so
+ * far. Returns -1 if all of them have been queued already. */
+int	input_wait_release(struct instance *i);
+/* Make all the waits for the streamed input return, used on exit */
+void	input_stop(struct instance *i);
 /* Unmap and close the input file */
 void	input_close(struct instance *i);
 
@@ -116,29 +116,42 @@ int fimc_sfmt(struct instance *i, int width, int height,
 	return 0;
 }
 
-int fimc_setup_output_from_mfc(struct instance *i)
+int fimc_setup_output(struct instance *i, int width, int height, int *sizes,
+								int count)
 {
 	struct v4l2_plane_pix_format planes[MFC_CAP_PLANES];
 	struct v4l2_requestbuffers reqbuf;
 	int ret;
 	int n;
 
+	memzero(reqbuf);
+	reqbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	reqbuf.memory = i->fimc.out_req_memory;
+
+	if (i->fimc.out_cnt) {
+		/* The format cannot be changed while buffers are allocated */
+		ret = ioctl(i->fimc.fd, VIDIOC_REQBUFS, &reqbuf);
+		if (ret) {
+			err("Failed to release OUTPUT buffers of FIMC");
+			return -1;
+		}
+		i->fimc.out_cnt = 0;
+	}
+
 	for (n = 0; n < MFC_CAP_PLANES; n++) {
-		planes[n].sizeimage = i->mfc.cap_buf_size[n];
-		planes[n].bytesperline = i->mfc.cap_w;
+		planes[n].sizeimage = sizes[n];
+		planes[n].bytesperline = width;
 	}
 
-	ret = fimc_sfmt(i, i->mfc.cap_w, i->mfc.cap_h,
+	ret = fimc_sfmt(i, width, height,
 		V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_PIX_FMT_NV12MT,
 		MFC_CAP_PLANES, planes);
 
 	if (ret)
 		return ret;
 
-	memzero(reqbuf);
-	reqbuf.count = i->mfc.cap_buf_cnt;
-	reqbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-	reqbuf.memory = V4L2_MEMORY_USERPTR;
+	reqbuf.count = count;
+	reqbuf.memory = i->fimc.out_memory;
 
 	ret = ioctl(i->fimc.fd, VIDIOC_REQBUFS, &reqbuf);
 	if (ret) {
@@ -146,11 +159,65 @@ int fimc_setup_output_from_mfc(struct instance *i)
 		return -1;
 	}
 
+	i->fimc.out_w = width;
+	i->fimc.out_h = height;
+	for (n = 0; n < MFC_CAP_PLANES; n++)
+		i->fimc.out_size[n] = sizes[n];
+	i->fimc.out_cnt = reqbuf.count;
+	i->fimc.out_req_memory = i->fimc.out_memory;
+
 	dbg("Succesfully setup OUTPUT of FIMC");
 
 	return 0;
 }
 
+int fimc_setup_output_from_mfc(struct instance *i)
+{
+	int n;
+
+	if (i->fimc.out_cnt >= i->mfc.cap_buf_cnt &&
+			i->fimc.out_req_memory == i->fimc.out_memory &&
+			i->fimc.out_w == i->mfc.cap_w &&
+			i->fimc.out_h == i->mfc.cap_h) {
+		for (n = 0; n < MFC_CAP_PLANES; n++)
+			if (i->fimc.out_size[n] != i->mfc.cap_buf_size[n])
+				break;
+		if (n == MFC_CAP_PLANES) {
+			dbg("OUTPUT of FIMC has already been setup");
+			return 0;
+		}
+	}
+
+	if (i->fimc.out_cnt)
+		dbg("The format set in advance does not match MFC (%dx%d)",
+			i->fimc.out_w, i->fimc.out_h);
+
+	return fimc_setup_output(i, i->mfc.cap_w, i->mfc.cap_h,
+				i->mfc.cap_buf_size, i->mfc.cap_buf_cnt);
+}
+
+/* Place the converted frames in a tile of the frame buffer. The tiles
+ * form a grid with as many columns as rows or one more. FIMC needs the
+ * size of the picture aligned to 16 pixels. */
+static int fimc_set_tile(struct instance *i)
+{
+	int cols, rows;
+	int w, h;
+
+	for (cols = 1; cols * cols < i->fimc.tiles; cols++)
+		;
+	rows = (i->fimc.tiles + cols - 1) / cols;
+
+	w = (i->fb.width / cols) & ~15;
+	h = (i->fb.height / rows) & ~15;
+
+	dbg("Stream shown in tile %d of %dx%d, %dx%d pixels", i->fimc.tile,
+							cols, rows, w, h);
+
+	return fimc_set_crop(i, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, w, h,
+			(i->fimc.tile % cols) * w, (i->fimc.tile / cols) * h);
+}
+
 int fimc_setup_capture_from_fb(struct instance *i)
 {
 	struct v4l2_plane_pix_format planes[MFC_OUT_PLANES];
@@ -190,6 +257,9 @@ int fimc_setup_capture_from_fb(struct instance *i)
 		return -1;
 	}
 
+	if (i->fimc.tiles > 1 && fimc_set_tile(i))
+		return -1;
+
 	dbg("Succesfully setup CAPTURE of FIMC");
 
 	return 0;
@@ -221,18 +291,27 @@ int fimc_dec_queue_buf_out_from_mfc(struct instance *i, int n)
 
 	memzero(buf);
 	buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-	buf.memory = V4L2_MEMORY_USERPTR;
+	buf.memory = i->fimc.out_memory;
 	buf.index = n;
 	buf.m.planes = planes;
 	buf.length = MFC_CAP_PLANES;
 
 	buf.m.planes[0].bytesused = i->mfc.cap_buf_size[0];
 	buf.m.planes[0].length = i->mfc.cap_buf_size[0];
-	buf.m.planes[0].m.userptr = (unsigned long)i->mfc.cap_buf_addr[n][0];
-
 	buf.m.planes[1].bytesused = i->mfc.cap_buf_size[1];
 	buf.m.planes[1].length = i->mfc.cap_buf_size[1];
-	buf.m.planes[1].m.userptr = (unsigned long)i->mfc.cap_buf_addr[n][1];
+
+	/* The buffer of MFC always goes to the FIMC buffer with the same
+	 * index, so FIMC keeps it attached between the frames */
+	if (i->fimc.out_memory == V4L2_MEMORY_DMABUF) {
+		buf.m.planes[0].m.fd = i->mfc.cap_buf_fd[n][0];
+		buf.m.planes[1].m.fd = i->mfc.cap_buf_fd[n][1];
+	} else {
+		buf.m.planes[0].m.userptr =
+				(unsigned long)i->mfc.cap_buf_addr[n][0];
+		buf.m.planes[1].m.userptr =
+				(unsigned long)i->mfc.cap_buf_addr[n][1];
+	}
 
 	ret = ioctl(i->fimc.fd, VIDIOC_QBUF, &buf);
 
@@ -283,7 +362,10 @@ int fimc_dec_dequeue_buf(struct instance *i, int *n, int nplanes, int type)
 
 	memzero(buf);
 	buf.type = type;
-	buf.memory = V4L2_MEMORY_USERPTR;
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+		buf.memory = i->fimc.out_memory;
+	else
+		buf.memory = V4L2_MEMORY_USERPTR;
 	buf.m.planes = planes;
 	buf.length = nplanes;
 
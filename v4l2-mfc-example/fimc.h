@@ -33,13 +33,22 @@ void	fimc_close(struct instance *i);
 int	fimc_sfmt(struct instance *i, int width, int height,
 		enum v4l2_buf_type type, unsigned long pix_fmt, int num_planes,
 		struct v4l2_plane_pix_format planes[]);
-/* Setup OUTPUT queue of FIMC basing on the configuration of MFC */
+/* Setup OUTPUT queue of FIMC for count NV12MT buffers of the given size and
+ * plane sizes, with the memory type in fimc.out_memory. Buffers allocated
+ * before are released. */
+int	fimc_setup_output(struct instance *i, int width, int height, int *sizes,
+								int count);
+/* Setup OUTPUT queue of FIMC basing on the configuration of MFC. Nothing is
+ * done if it has already been setup with the same format and enough
+ * buffers. */
 int	fimc_setup_output_from_mfc(struct instance *i);
-/* Setup CAPTURE queue of FIMC basing on the configuration of the frame buffer */
+/* Setup CAPTURE queue of FIMC basing on the configuration of the frame buffer.
+ * When several streams are shown the frame is placed in the tile of the
+ * stream. */
 int	fimc_setup_capture_from_fb(struct instance *i);
 /* Control streaming status */
 int	fimc_stream(struct instance *i, enum v4l2_buf_type type, int status);
-/* Convenience function for queueing buffers from MFC */
+/* Convenience function for queueing buffers from MFC, as DMABUF or USERPTR */
 int	fimc_dec_queue_buf_out_from_mfc(struct instance *i, int n);
 /* Convenience function for queueing buffers from  frame buffer*/
 int	fimc_dec_queue_buf_cap_from_fb(struct instance *i, int n);
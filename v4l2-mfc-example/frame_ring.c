@@ -0,0 +1,67 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Frame descriptor ring
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "frame_ring.h"
+
+void frame_ring_init(struct frame_ring *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+int frame_ring_push(struct frame_ring *r, const struct frame_desc *d)
+{
+	unsigned int head = r->head;
+
+	while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) ==
+							FRAME_RING_SIZE)
+		if (queue_sync_wait(&r->sync, &r->tail, head - FRAME_RING_SIZE))
+			return -1;
+
+	r->d[head % FRAME_RING_SIZE] = *d;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+	queue_sync_wake(&r->sync);
+
+	return 0;
+}
+
+int frame_ring_pop(struct frame_ring *r, struct frame_desc *d)
+{
+	unsigned int tail = r->tail;
+
+	while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+		if (queue_sync_wait(&r->sync, &r->head, tail))
+			return -1;
+
+	*d = r->d[tail % FRAME_RING_SIZE];
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+	queue_sync_wake(&r->sync);
+
+	return 0;
+}
+
+void frame_ring_close(struct frame_ring *r)
+{
+	queue_sync_close(&r->sync);
+}
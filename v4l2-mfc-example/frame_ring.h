@@ -0,0 +1,64 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Frame descriptor ring header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef INCLUDE_FRAME_RING_H
+#define INCLUDE_FRAME_RING_H
+
+#include <stdint.h>
+
+#include "queue.h"
+
+/* Number of frames the parser can run ahead of the OUTPUT queue. It has
+ * to be a power of two. */
+#define FRAME_RING_SIZE		16
+
+/* A frame found by the parser. The offset is the position in the input
+ * stream, size 0 marks the end of the stream. */
+struct frame_desc {
+	uint64_t offs;
+	int size;
+	int flags;
+};
+
+/* Single producer, single consumer ring of frame descriptors. Passing a
+ * descriptor does not take a lock, the sides only sleep when the ring is
+ * empty or full. */
+struct frame_ring {
+	struct frame_desc d[FRAME_RING_SIZE];
+	/* Written only by the producer and the consumer respectively, kept
+	 * in separate cache lines */
+	unsigned int head __attribute__((aligned(64)));
+	unsigned int tail __attribute__((aligned(64)));
+	struct queue_sync sync __attribute__((aligned(64)));
+};
+
+/* Initialize the ring */
+void	frame_ring_init(struct frame_ring *r);
+/* Add a descriptor, waiting while the ring is full. Returns -1 if the
+ * ring has been closed. */
+int	frame_ring_push(struct frame_ring *r, const struct frame_desc *d);
+/* Take the next descriptor, waiting while the ring is empty. Returns -1
+ * if the ring has been closed. */
+int	frame_ring_pop(struct frame_ring *r, struct frame_desc *d);
+/* Wake up and fail all the current and future waits */
+void	frame_ring_close(struct frame_ring *r);
+
+#endif /* INCLUDE_FRAME_RING_H */
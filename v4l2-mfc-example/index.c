@@ -0,0 +1,199 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Frame index
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "index.h"
+#include "parser.h"
+
+/* Number of entries the index grows by */
+#define INDEX_ALLOC_STEP	4096
+
+static void index_fill_header(struct frame_index_header *h, struct stat *st,
+					unsigned long codec, int count)
+{
+	memzero(*h);
+	memcpy(h->magic, INDEX_MAGIC, sizeof(h->magic));
+	h->version = INDEX_VERSION;
+	h->codec = codec;
+	h->file_size = st->st_size;
+	h->file_mtime = st->st_mtime;
+	h->count = count;
+}
+
+int index_load(struct frame_index *idx, int in_fd, unsigned long codec)
+{
+	struct frame_index_header h, *fh;
+	struct stat in_stat, idx_stat;
+	void *map;
+	int fd;
+
+	fd = open(idx->name, O_RDONLY);
+	if (fd < 0) {
+		dbg("No frame index in %s", idx->name);
+		return -1;
+	}
+
+	if (fstat(fd, &idx_stat) || fstat(in_fd, &in_stat)) {
+		err("Failed to stat the stream or its index");
+		close(fd);
+		return -1;
+	}
+
+	if (idx_stat.st_size < sizeof(h)) {
+		dbg("Frame index %s is too short", idx->name);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(0, idx_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		err("Failed to map frame index");
+		return -1;
+	}
+
+	fh = map;
+	index_fill_header(&h, &in_stat, codec, fh->count);
+	if (memcmp(fh, &h, sizeof(h)) || idx_stat.st_size != sizeof(h) +
+			(unsigned long)h.count * sizeof(*idx->e) ||
+			h.count < 1) {
+		dbg("Frame index %s does not match the stream", idx->name);
+		munmap(map, idx_stat.st_size);
+		return -1;
+	}
+
+	idx->map = map;
+	idx->map_size = idx_stat.st_size;
+	idx->e = (struct frame_index_entry *)(fh + 1);
+	idx->count = h.count;
+	idx->alloc = 0;
+	idx->cur = 0;
+	idx->loaded = 1;
+
+	dbg("Loaded frame index %s with %d entries", idx->name, idx->count);
+
+	return 0;
+}
+
+int index_add(struct frame_index *idx, uint64_t offs, int size, int flags,
+								int type)
+{
+	struct frame_index_entry *e;
+
+	if (idx->count == idx->alloc) {
+		e = realloc(idx->e, (idx->alloc + INDEX_ALLOC_STEP) *
+							sizeof(*idx->e));
+		if (!e) {
+			err("Failed to grow the frame index");
+			return -1;
+		}
+		idx->e = e;
+		idx->alloc += INDEX_ALLOC_STEP;
+	}
+
+	e = &idx->e[idx->count++];
+	e->offs = offs;
+	e->size = size;
+	e->flags = flags;
+	e->type = type;
+
+	return 0;
+}
+
+int index_save(struct frame_index *idx, int in_fd, unsigned long codec)
+{
+	struct frame_index_header h;
+	struct stat in_stat;
+	char tmp_name[1024];
+	int size;
+	int fd;
+
+	if (fstat(in_fd, &in_stat)) {
+		err("Failed to stat the stream");
+		return -1;
+	}
+	index_fill_header(&h, &in_stat, codec, idx->count);
+
+	/* The index is written to a temporary file first, so an interrupted
+	 * write never leaves a broken index behind */
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", idx->name);
+	fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		err("Failed to create frame index: %s", tmp_name);
+		return -1;
+	}
+
+	size = idx->count * sizeof(*idx->e);
+	if (write(fd, &h, sizeof(h)) != sizeof(h) ||
+				write(fd, idx->e, size) != size) {
+		err("Failed to write frame index: %s", tmp_name);
+		close(fd);
+		unlink(tmp_name);
+		return -1;
+	}
+	close(fd);
+
+	if (rename(tmp_name, idx->name)) {
+		err("Failed to rename frame index to %s", idx->name);
+		unlink(tmp_name);
+		return -1;
+	}
+
+	dbg("Saved frame index %s with %d entries", idx->name, idx->count);
+
+	return 0;
+}
+
+int index_find_key(struct frame_index *idx, int n)
+{
+	/* Entry 0 is the stream header */
+	n++;
+	if (n >= idx->count)
+		n = idx->count - 1;
+
+	for (; n > 0; n--)
+		if (idx->e[n].flags & PARSER_FRAME_KEY)
+			return n;
+
+	return -1;
+}
+
+void index_free(struct frame_index *idx)
+{
+	if (idx->loaded)
+		munmap(idx->map, idx->map_size);
+	else
+		free(idx->e);
+	idx->e = NULL;
+	idx->count = 0;
+	idx->alloc = 0;
+	idx->loaded = 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Frame index header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_INDEX_H
+#define INCLUDE_INDEX_H
+
+#include <stdint.h>
+
+/* The index file starts with the header which is followed by count
+ * entries. Both use the native byte order. The size and modification time
+ * of the stream are stored to detect a stale index. */
+#define INDEX_MAGIC	"MFCINDEX"
+#define INDEX_VERSION	1
+
+struct frame_index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t codec;
+	uint64_t file_size;
+	int64_t file_mtime;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+/* A single frame (or the stream header) as it is queued to MFC. The flags
+ * are the PARSER_FRAME_* flags and the type is the codec specific
+ * frame_type returned by the parser. */
+struct frame_index_entry {
+	uint64_t offs;
+	uint32_t size;
+	uint16_t flags;
+	uint16_t type;
+};
+
+struct frame_index {
+	/* Name of the index file, NULL if the index is not used */
+	char *name;
+	/* Set when the index has been loaded from the file. Otherwise it is
+	 * built while parsing the stream. */
+	int loaded;
+	struct frame_index_entry *e;
+	int count;
+	int alloc;
+	/* Next entry to be queued */
+	int cur;
+	/* Mapping of the loaded index file */
+	void *map;
+	unsigned long map_size;
+};
+
+/* Load and mmap the index. Returns 0 if it is valid for the stream that
+ * is opened as in_fd and the given codec. */
+int	index_load(struct frame_index *idx, int in_fd, unsigned long codec);
+/* Add a frame to the index that is being built */
+int	index_add(struct frame_index *idx, uint64_t offs, int size, int flags,
+								int type);
+/* Write the index that has been built to the index file */
+int	index_save(struct frame_index *idx, int in_fd, unsigned long codec);
+/* Find the last key frame that is not after the frame n. The stream header
+ * is not counted, so frame 0 is the first entry after it. Returns the
+ * number of the entry or -1 if there is none. */
+int	index_find_key(struct frame_index *idx, int n);
+/* Free the index */
+void	index_free(struct frame_index *idx);
+
+#endif /* INCLUDE_INDEX_H */
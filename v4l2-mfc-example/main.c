@@ -20,72 +20,381 @@
  *
  */
 
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <linux/videodev2.h>
 #include <pthread.h>
-#include <semaphore.h>
 
 #include "args.h"
+#include "bufsize.h"
 #include "common.h"
 #include "fb.h"
 #include "fimc.h"
 #include "fileops.h"
+#include "index.h"
 #include "mfc.h"
 #include "parser.h"
-
-/* This is the size of the buffer for the compressed stream.
- * It limits the maximum compressed frame size. */
-#define STREAM_BUUFER_SIZE	(1024 * 1024)
-/* The number of compress4ed stream buffers */
-#define STREAM_BUFFER_CNT	2
+#include "pindex.h"
+#include "probe.h"
 
 /* The number of extra buffers for the decoded output.
  * This is the number of buffers that the application can keep
  * used and still enable MFC to decode with the hardware. */
 #define RESULT_EXTRA_BUFFER_CNT 2
 
+/* Descriptors polled for each stream by the single threaded loop: MFC,
+ * FIMC and the streamed input */
+#define EVENT_FDS	3
+
+/* Setup of the frame buffer and FIMC done in parallel with the header
+ * processing in MFC */
+struct setup_job {
+	struct instance *i;
+	pthread_t thread;
+	int ret;
+	/* Time taken by the setup in ms */
+	double time;
+};
+
+/* Monotonic time in ms, used to measure the startup phases */
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
 void cleanup(struct instance *i)
 {
 	if (i->mfc.fd)
 		mfc_close(i);
 	if (i->fimc.fd)
 		fimc_close(i);
-	if (i->fb.fd)
+	if (i->fb.fd && !i->fb.shared)
 		fb_close(i);
-	if (i->in.fd)
+	if (i->in.p || i->in.windowed)
 		input_close(i);
+	index_free(&i->index);
 	queue_free(&i->fimc.queue);
+	queue_free(&i->fimc.done);
 }
 
-int extract_and_process_header(struct instance *i)
+/* Queue a frame on the OUTPUT queue. The frame is a span of the mmapped
+ * input file. With USERPTR it is passed to MFC where it lies, otherwise
+ * it is copied to the OUTPUT buffer in one step. The samples of MP4 files
+ * get start codes while they are copied. */
+int queue_frame(struct instance *i, int n, char *p, int size)
 {
-	int used, fs;
-	int ret;
+	if (i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		/* Even the empty buffer has to point to valid memory */
+		if (size == 0)
+			return mfc_dec_queue_buf_out_userptr(i, n, i->in.p,
+								0, 1);
+		return mfc_dec_queue_buf_out_userptr(i, n, p, size, size);
+	}
 
-	ret = i->parser.func(&i->parser.ctx, i->in.p + i->in.offs,
-		i->in.size - i->in.offs, i->mfc.out_buf_addr[0],
-		i->mfc.out_buf_size, &used, &fs, 1);
+	if (i->in.mp4.loaded) {
+		size = mp4_copy(&i->in.mp4, i->mfc.out_buf_addr[n],
+						i->mfc.out_buf_size, p, size);
+		if (size < 0)
+			return -1;
+		return mfc_dec_queue_buf_out(i, n, size);
+	}
 
-	if (ret == 0) {
-		err("Failed to extract header from stream");
+	if (size > i->mfc.out_buf_size) {
+		err("Output buffer too small for current frame");
 		return -1;
 	}
+	memcpy(i->mfc.out_buf_addr[n], p, size);
+
+	return mfc_dec_queue_buf_out(i, n, size);
+}
+
+/* Add the extracted frame to the frame index that is being built */
+void record_frame(struct instance *i, uint64_t offs, int fs)
+{
+	if (!i->index.name || i->index.loaded || i->in.stream)
+		return;
+
+	if (index_add(&i->index, offs, fs,
+		i->parser.ctx.frame_flags, i->parser.ctx.frame_type)) {
+		/* Decoding can go on without the index */
+		index_free(&i->index);
+		i->index.name = NULL;
+	}
+}
+
+/* Account the extracted frame in the statistics of the stream */
+void count_frame(struct instance *i, int size, int flags, int coding)
+{
+	if (i->parser.stats_name)
+		stats_frame(&i->parser.stats, size, flags, coding);
+}
+
+/* For H263 and VP8 the header is passed with the first frame, so the frame
+ * is extracted again after the header */
+int header_is_frame(struct instance *i)
+{
+	return i->parser.codec == V4L2_PIX_FMT_H263 ||
+				i->parser.codec == V4L2_PIX_FMT_VP8;
+}
+
+/* Find the next frame (or the stream header) in the input. The parser
+ * only finds the frame, copying (if needed) is done by queue_frame. With
+ * streamed input the parser is run again from the same point when the
+ * frame does not end in the data read so far. The data of the frame stays
+ * in the ring until it is released after queueing. The position of the
+ * frame in the stream is returned in offs. The single threaded loop does
+ * not wait for streamed input, it goes on with the other streams.
+ * Return value: 1 - if a frame has been extracted, 0 when there are no more
+ * frames, 2 if the frame has not arrived yet, -1 on error */
+int parse_frame(struct instance *i, char **p, int *fs, uint64_t *offs,
+								int get_head)
+{
+	unsigned int units[STATS_UNIT_TYPES];
+	struct mfc_parser_context ctx;
+	int used, ret, len, eof;
+	int want = 0;
+	int max;
+	char *data;
+
+	/* The OUTPUT buffers are allocated after the header has been found,
+	 * until then the size of the frame is not limited */
+	max = i->mfc.out_buf_size ? i->mfc.out_buf_size : INT_MAX;
+
+	while (1) {
+		if (i->in.event && !input_ready(i, want))
+			return 2;
+		data = input_data(i, want, &len, &eof);
+		if (!data)
+			return -1;
+		ctx = i->parser.ctx;
+		/* The units found by the parser are counted again when it
+		 * is run again */
+		if (ctx.stats)
+			memcpy(units, ctx.stats->units, sizeof(units));
+		ret = i->parser.func(&i->parser.ctx, data, len, NULL,
+						max, &used, fs, get_head);
+		if (ret == 1 || eof)
+			break;
+
+		/* Wait for more data and parse the frame from its start */
+		i->parser.ctx = ctx;
+		if (ctx.stats)
+			memcpy(ctx.stats->units, units, sizeof(units));
+		if (len >= input_space(i) && input_wait_release(i)) {
+			err("Frame too large for the input ring");
+			return -1;
+		}
+		want = 2 * len;
+		if (want >= input_space(i))
+			want = input_space(i) - 1;
+	}
+
+	if (ret == 0 && (len == 0 || get_head))
+		return 0;
+
+	/* The data left at the end of the stream holds no frame, for
+	 * example when the last frame of an RCV or IVF file is truncated */
+	if (*fs == 0) {
+		dbg("Ignoring %d bytes at the end of the stream", len);
+		return 0;
+	}
+
+	*p = data + i->parser.ctx.frame_offs;
+	*offs = input_tell(i) + i->parser.ctx.frame_offs;
+	record_frame(i, *offs, *fs);
 
-	/* For H263 the header is passed with the first frame, so we should
-	 * pass it again */
-	if (i->parser.codec != V4L2_PIX_FMT_H263)
-		i->in.offs += used;
-	else
-	/* To do this we shall reset the stream parser to the initial
-	 * configuration */
+	/* For H263 and VP8 the header is passed with the first frame, so we
+	 * should pass it again */
+	if (get_head && header_is_frame(i)) {
+		/* To do this we shall reset the stream parser to the initial
+		 * configuration */
 		parse_stream_init(&i->parser.ctx);
+		i->parser.ctx.stats = ctx.stats;
+		if (ctx.stats)
+			memcpy(ctx.stats->units, units, sizeof(units));
+		return 1;
+	}
+
+	input_advance(i, used, i->parser.ctx.frame_offs + *fs);
+
+	return 1;
+}
+
+/* Get the stream header from the sample description of the MP4 track */
+int extract_mp4_header(struct instance *i, char **p, int *fs)
+{
+	struct mp4_demux *m = &i->in.mp4;
+	uint64_t offs;
+	int flags, n;
+
+	if (m->header) {
+		*p = m->header;
+		*fs = m->header_size;
+	} else {
+		/* The header is passed with the first frame, so we should
+		 * pass it again */
+		if (mp4_next(m, &offs, fs, &flags)) {
+			err("Failed to extract header from stream");
+			return -1;
+		}
+		*p = i->in.p + offs;
+		mp4_seek_key(m, 0);
+	}
+
+	if (i->parser.seek) {
+		/* Decoding has to start from a key frame */
+		n = mp4_seek_key(m, i->parser.seek);
+		if (n < 0) {
+			err("No key frame before frame %d", i->parser.seek);
+			return -1;
+		}
+		dbg("Starting from key frame %d", n);
+	}
+
+	return 0;
+}
+
+/* Get the stream header, either from the frame index or by parsing the
+ * beginning of the stream */
+int extract_header(struct instance *i, char **p, int *fs)
+{
+	uint64_t offs;
+	int n;
+
+	if (i->in.mp4.loaded)
+		return extract_mp4_header(i, p, fs);
+
+	if (i->index.loaded) {
+		if (!(i->index.e[0].flags & PARSER_FRAME_HEAD)) {
+			err("Frame index does not start with the stream header");
+			return -1;
+		}
+		*fs = i->index.e[0].size;
+		*p = input_ptr(i, i->index.e[0].offs, *fs);
+		if (!*p)
+			return -1;
+		i->index.cur = 1;
+		if (!header_is_frame(i))
+			count_frame(i, *fs, i->index.e[0].flags,
+							PARSER_CODING_UNKNOWN);
+
+		if (i->parser.seek) {
+			/* Decoding has to start from a key frame */
+			n = index_find_key(&i->index, i->parser.seek);
+			if (n < 0) {
+				err("No key frame before frame %d",
+							i->parser.seek);
+				return -1;
+			}
+			dbg("Starting from key frame %d", n - 1);
+			i->index.cur = n;
+		}
+
+		return 0;
+	}
+
+	if (i->parser.seek)
+		dbg("Seeking requires a frame index, starting from frame 0");
+
+	if (parse_frame(i, p, fs, &offs, 1) != 1) {
+		err("Failed to extract header from stream");
+		return -1;
+	}
+	if (!header_is_frame(i))
+		count_frame(i, *fs, i->parser.ctx.frame_flags,
+					i->parser.ctx.frame_coding);
+
+	return 0;
+}
+
+/* Get the next frame, either from the MP4 sample tables, the frame index
+ * or by parsing the stream. Return value: 1 - if a frame has been
+ * extracted, 0 when there are no more frames, 2 if the streamed input has
+ * to be waited for, -1 on error */
+int extract_frame(struct instance *i, struct frame_desc *f)
+{
+	struct frame_index_entry *e;
+	char *p;
+	int ret;
+
+	/* Only the parser knows the coding type of the pictures */
+	if (i->in.mp4.loaded) {
+		if (mp4_next(&i->in.mp4, &f->offs, &f->size, &f->flags))
+			return i->in.mp4.sample < i->in.mp4.sample_count ? -1 : 0;
+		count_frame(i, f->size, f->flags, PARSER_CODING_UNKNOWN);
+		return 1;
+	}
+
+	if (i->index.loaded) {
+		if (i->index.cur >= i->index.count)
+			return 0;
+		e = &i->index.e[i->index.cur++];
+		f->offs = e->offs;
+		f->size = e->size;
+		f->flags = e->flags;
+		count_frame(i, f->size, f->flags, PARSER_CODING_UNKNOWN);
+		return 1;
+	}
+
+	ret = parse_frame(i, &p, &f->size, &f->offs, 0);
+	f->flags = i->parser.ctx.frame_flags;
+	if (ret == 1)
+		count_frame(i, f->size, f->flags,
+					i->parser.ctx.frame_coding);
+	return ret;
+}
+
+int extract_and_process_header(struct instance *i)
+{
+	char *head;
+	int fs;
+	int size, count;
+	int ret;
+	int n;
+
+	if (extract_header(i, &head, &fs))
+		return -1;
 
 	dbg("Extracted header of size %d", fs);
 
-	ret = mfc_dec_queue_buf_out(i, 0, fs);
+	/* The resolution is needed by the setup done while MFC is
+	 * processing the header */
+	if (probe_header(&i->parser.probe, i->parser.codec, head, fs,
+						i->in.mp4.length_size))
+		dbg("The resolution could not be read from the header");
 
-	if (ret)
+	bufsize_choose(i, &size, &count);
+	if (mfc_dec_setup_output(i, i->parser.codec, size, count))
+		return -1;
+
+	n = buf_list_get(&i->mfc.out_free);
+	ret = queue_frame(i, n, head, fs);
+
+	if (ret && i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		/* The driver accepted USERPTR buffers, but cannot use the
+		 * memory of the input file. Setup the queue again with MMAP
+		 * and copy the stream. */
+		dbg("Failed to use the input file memory, switching to MMAP");
+		size = i->mfc.out_buf_size;
+		count = i->mfc.out_buf_cnt;
+		if (mfc_dec_release_output(i))
+			return -1;
+		i->mfc.out_memory = V4L2_MEMORY_MMAP;
+		if (mfc_dec_setup_output(i, i->parser.codec, size, count))
+			return -1;
+		n = buf_list_get(&i->mfc.out_free);
+		ret = queue_frame(i, n, head, fs);
+	}
+
+	if (ret || buf_move(&i->mfc.out_buf_state[n], BUF_FREE, BUF_MFC))
 		return -1;
 
 	ret = mfc_stream(i, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, VIDIOC_STREAMON);
@@ -103,7 +412,7 @@ int dequeue_output(struct instance *i, int *n)
 
 	memzero(qbuf);
 	qbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-	qbuf.memory = V4L2_MEMORY_MMAP;
+	qbuf.memory = i->mfc.out_memory;
 	qbuf.m.planes = planes;
 	qbuf.length = 1;
 
@@ -115,6 +424,15 @@ int dequeue_output(struct instance *i, int *n)
 	return 0;
 }
 
+/* Return the OUTPUT buffer n dequeued from MFC to the free list */
+int release_output(struct instance *i, int n)
+{
+	if (buf_move(&i->mfc.out_buf_state[n], BUF_MFC, BUF_FREE))
+		return -1;
+	buf_list_put(&i->mfc.out_free, n);
+	return 0;
+}
+
 int dequeue_capture(struct instance *i, int *n, int *finished)
 {
 	struct v4l2_buffer qbuf;
@@ -136,55 +454,130 @@ int dequeue_capture(struct instance *i, int *n, int *finished)
 	return 0;
 }
 
-/* This threads is responsible for parsing the stream and
- * feeding MFC with consecutive frames to decode */
+/* Stop the decoding threads after an error. Stopping the streaming of MFC
+ * makes a thread waiting in DQBUF return, the threads waiting for each
+ * other are woken up by closing their rings. */
+void abort_decoding(struct instance *i)
+{
+	i->error = 1;
+	frame_ring_close(&i->parser.ahead);
+	input_stop(i);
+	queue_close(&i->fimc.queue);
+	queue_close(&i->fimc.done);
+	mfc_stream(i, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, VIDIOC_STREAMOFF);
+	mfc_stream(i, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, VIDIOC_STREAMOFF);
+}
+
+/* This thread parses the stream ahead of the parser thread. The frames
+ * that have been found are passed to it through the frame ring, so MFC
+ * does not wait for the parser when an OUTPUT buffer is returned. */
+void *parse_ahead_thread_func(void *args)
+{
+	struct instance *i = (struct instance *)args;
+	struct frame_desc f;
+	int ret;
+
+	while (!i->error && !i->finish) {
+		ret = extract_frame(i, &f);
+
+		if (ret < 0) {
+			abort_decoding(i);
+			break;
+		}
+
+		if (ret == 0) {
+			/* The empty frame marks the end of the stream */
+			f.offs = 0;
+			f.size = 0;
+			f.flags = 0;
+		}
+
+		if (frame_ring_push(&i->parser.ahead, &f))
+			break;
+
+		if (ret == 0) {
+			dbg("Parser has extracted all frames");
+			break;
+		}
+	}
+
+	/* Do not leave the parser thread waiting for frames */
+	if (i->error)
+		frame_ring_close(&i->parser.ahead);
+
+	dbg("Parse ahead thread finished");
+	return 0;
+}
+
+/* This threads is responsible for feeding MFC with consecutive frames to
+ * decode. The frames are taken from the parse ahead thread. */
 void *parser_thread_func(void *args)
 {
 	struct instance *i = (struct instance *)args;
+	struct frame_desc f;
+	char *p;
 	int ret;
-	int used, fs, n;
+	int n;
 
 	while (!i->error && !i->finish && !i->parser.finished) {
-		n = 0;
-		while (n < i->mfc.out_buf_cnt && i->mfc.out_buf_flag[n])
-			n++;
-
-		if (n < i->mfc.out_buf_cnt && !i->parser.finished) {
-			dbg("parser.func = %p", i->parser.func);
-			ret = i->parser.func(&i->parser.ctx,
-				i->in.p + i->in.offs, i->in.size - i->in.offs,
-				i->mfc.out_buf_addr[n], i->mfc.out_buf_size,
-				&used, &fs, 0);
+		n = buf_list_get(&i->mfc.out_free);
 
+		if (n >= 0) {
+			if (frame_ring_pop(&i->parser.ahead, &f)) {
+				buf_list_put(&i->mfc.out_free, n);
+				break;
+			}
 
-			if (ret == 0 && i->in.offs == i->in.size) {
-				dbg("Parser has extracted all frames");
+			if (f.size == 0) {
+				dbg("All frames have been queued");
 				i->parser.finished = 1;
-				fs = 0;
 			}
 
-			dbg("Extracted frame of size %d", fs);
+			p = input_ptr(i, f.offs, f.size);
+			ret = -1;
+			if (p) {
+				dbg("Extracted frame of size %d", f.size);
 
-			dbg("Before OUTPUT queue");
-			ret = mfc_dec_queue_buf_out(i, n, fs);
-			dbg("After OUTPUT queue");
+				dbg("Before OUTPUT queue");
+				ret = queue_frame(i, n, p, f.size);
+				dbg("After OUTPUT queue");
+			}
 
-			i->mfc.out_buf_flag[n] = 1;
+			/* The buffer has not been queued, MFC will not
+			 * return it */
+			if (ret) {
+				buf_list_put(&i->mfc.out_free, n);
+				abort_decoding(i);
+				break;
+			}
 
-			i->in.offs += used;
+			if (buf_move(&i->mfc.out_buf_state[n], BUF_FREE,
+								BUF_MFC)) {
+				abort_decoding(i);
+				break;
+			}
 
+			/* The frame has been copied, its part of the ring can
+			 * be filled again */
+			input_release(i, f.offs + f.size);
 
 		} else {
 			dbg("Before OUTPUT dequeue");
 			ret = dequeue_output(i, &n);
 			dbg("After OUTPUT dequeue");
-			i->mfc.out_buf_flag[n] = 0;
 			if (ret && !i->parser.finished) {
 				err("Failed to dequeue a buffer in parser_thread");
-				i->error = 1;
+				abort_decoding(i);
 			}
+			if (!ret && release_output(i, n))
+				abort_decoding(i);
 		}
 	}
+
+	/* The parse ahead thread may be waiting for the ring or the input */
+	frame_ring_close(&i->parser.ahead);
+	input_stop(i);
+
 	dbg("Parser thread finished");
 	return 0;
 }
@@ -201,47 +594,35 @@ void *mfc_thread_func(void *args)
 
 	while (!i->error && !i->finish) {
 		if (i->mfc.cap_buf_queued < i->mfc.cap_buf_cnt_min) {
-			/* sem_wait - wait until there is a buffer returned from
-			 * fimc */
+			/* Wait until there is a buffer returned from fimc */
 			dbg("Before fimc.done");
-			sem_wait(&i->fimc.done);
+			n = queue_wait(&i->fimc.done);
 			dbg("After fimc.done");
 
-			n = 0;
-			while (n < i->mfc.cap_buf_cnt &&
-				i->mfc.cap_buf_flag[n] != BUF_FREE)
-				n++;
-
-			if (n < i->mfc.cap_buf_cnt) {
-				/* Can queue a buffer */
-				mfc_dec_queue_buf_cap(i, n);
-				i->mfc.cap_buf_flag[n] = 1;
-				i->mfc.cap_buf_queued++;
-			} else {
-				err("Something went seriously wrong. There should be a buffer");
-				i->error = 1;
-				continue;
+			if (n < 0 || buf_move(&i->mfc.cap_buf_state[n], BUF_FREE,
+								BUF_MFC)) {
+				abort_decoding(i);
+				break;
 			}
 
+			/* Can queue a buffer */
+			mfc_dec_queue_buf_cap(i, n);
+			i->mfc.cap_buf_queued++;
 			continue;
 		}
 
 		if (i->mfc.cap_buf_queued < i->mfc.cap_buf_cnt) {
-			n = 0;
-			while (n < i->mfc.cap_buf_cnt &&
-				i->mfc.cap_buf_flag[n] != BUF_FREE)
-				n++;
-
-			if (n < i->mfc.cap_buf_cnt) {
-				/* sem_wait - we already found a buffer to queue
-				 * so no waiting */
-				dbg("Before fimc.done");
-				sem_wait(&i->fimc.done);
-				dbg("After fimc.done");
-
-				/* Can queue a buffer */
+			/* Queue a buffer if fimc has already returned one, no
+			 * waiting */
+			n = queue_remove(&i->fimc.done);
+
+			if (n >= 0) {
+				if (buf_move(&i->mfc.cap_buf_state[n],
+							BUF_FREE, BUF_MFC)) {
+					abort_decoding(i);
+					break;
+				}
 				mfc_dec_queue_buf_cap(i, n);
-				i->mfc.cap_buf_flag[n] = BUF_MFC;
 				i->mfc.cap_buf_queued++;
 				continue;
 			}
@@ -251,7 +632,7 @@ void *mfc_thread_func(void *args)
 			/* Can dequeue a processed buffer */
 			if (dequeue_capture(i, &n, &finished)) {
 				err("Error when dequeueing CAPTURE buffer");
-				i->error = 1;
+				abort_decoding(i);
 				break;
 			}
 
@@ -262,198 +643,546 @@ void *mfc_thread_func(void *args)
 			}
 
 			/* Pass to the FIMC */
-			i->mfc.cap_buf_flag[n] = BUF_FIMC;
+			if (buf_move(&i->mfc.cap_buf_state[n], BUF_MFC,
+								BUF_FIMC)) {
+				abort_decoding(i);
+				break;
+			}
 			i->mfc.cap_buf_queued--;
 			queue_add(&i->fimc.queue, n);
 
-			sem_post(&i->fimc.todo);
-
 			continue;
 		}
 	}
 
+	/* FIMC finishes the frames that are left and stops */
+	queue_close(&i->fimc.queue);
+
 	dbg("MFC thread finished");
 	return 0;
 }
 
+/* Pass the decoded frame in the CAPTURE buffer n of MFC to FIMC, which
+ * converts it to the frame buffer */
+int fimc_process_start(struct instance *i, int n)
+{
+	if (n >= i->mfc.cap_buf_cnt) {
+		err("Strange. Could not find the buffer to process.");
+		return -1;
+	}
+
+	if (buf_move(&i->mfc.cap_buf_state[n], BUF_FIMC, BUF_DISPLAY))
+		return -1;
+
+	if (fimc_dec_queue_buf_out_from_mfc(i, n))
+		return -1;
+
+	i->fb.cur_buf = 0;
+
+	if (i->fb.double_buf) {
+		i->fb.cur_buf++;
+		i->fb.cur_buf %= i->fb.buffers;
+	}
+
+	if (fimc_dec_queue_buf_cap_from_fb(i, i->fb.cur_buf))
+		return -1;
+
+	if (!i->fimc.streaming) {
+		/* Since our fabulous V4L2 framework enforces that at
+		 * least one buffer is queued before switching streaming
+		 * on then we need to add the following code. Otherwise
+		 * it could be ommited and it all would be handled by
+		 * the setup sequence in main.*/
+		i->fimc.streaming = 1;
+
+		if (fimc_stream(i, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+						VIDIOC_STREAMON))
+			return -1;
+		if (fimc_stream(i, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+						VIDIOC_STREAMON))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Dequeue the buffers of the frame converted by FIMC and show it. The
+ * CAPTURE buffer n of MFC is free again. */
+int fimc_process_finish(struct instance *i, int n)
+{
+	int tmp;
+
+	if (fimc_dec_dequeue_buf_cap(i, &tmp))
+		return -1;
+	if (fimc_dec_dequeue_buf_out(i, &tmp))
+		return -1;
+
+	if (i->fb.double_buf) {
+		fb_set_virt_y_offset(i, i->fb.height);
+		fb_wait_for_vsync(i);
+	}
+
+	i->frames++;
+	i->end = now_ms();
+
+	return buf_move(&i->mfc.cap_buf_state[n], BUF_DISPLAY, BUF_FREE);
+}
+
 /* This thread handles FIMC processing and optionally frame buffer
  * switching and synchronisation to the vsync of frame buffer. */
 void *fimc_thread_func(void *args)
 {
-	static int frames = 0;
-	static int first_run = 1;
 	struct instance *i = (struct instance *)args;
-	int n, tmp;
+	int n;
 
-	while (!i->error && (!i->finish ||
-		(i->finish && !queue_empty(&i->fimc.queue))
-		)) {
-		dbg("Before fimc.todo");
-		sem_wait(&i->fimc.todo);
-		dbg("After fimc.todo");
+	while (!i->error) {
+		dbg("Before fimc.queue");
+		n = queue_wait(&i->fimc.queue);
+		dbg("After fimc.queue");
 
-		dbg("Processing by FIMC");
+		/* MFC has finished and all the frames have been processed */
+		if (n < 0)
+			break;
 
-		n = queue_remove(&i->fimc.queue);
+		dbg("Processing by FIMC");
 
-		if (i->mfc.cap_buf_flag[n] != BUF_FIMC) {
-			err("Buffer chosen to be processed by FIMC in wrong");
-			i->error = 1;
+		if (fimc_process_start(i, n)) {
+			abort_decoding(i);
 			break;
 		}
 
-		if (n >= i->mfc.cap_buf_cnt) {
-			err("Strange. Could not find the buffer to process.");
-			i->error = 1;
+		if (fimc_process_finish(i, n)) {
+			abort_decoding(i);
 			break;
 		}
 
-		if (fimc_dec_queue_buf_out_from_mfc(i, n)) {
-			i->error = 1;
+		dbg("Processed frame number: %d", i->frames);
+
+		queue_add(&i->fimc.done, n);
+	}
+
+	queue_close(&i->fimc.done);
+
+	dbg("FIMC thread finished");
+	return 0;
+}
+
+/* Queue frames to the free OUTPUT buffers of the stream and start FIMC
+ * on the next decoded frame if it is idle. The empty buffer after the last
+ * frame tells MFC to return the remaining frames. */
+int event_queue(struct instance *i)
+{
+	struct frame_desc f;
+	char *p;
+	int ret;
+	int n;
+
+	while (!i->parser.finished &&
+			(n = buf_list_get(&i->mfc.out_free)) >= 0) {
+		ret = extract_frame(i, &f);
+		if (ret < 0 || ret == 2)
+			buf_list_put(&i->mfc.out_free, n);
+		if (ret < 0)
+			return -1;
+		/* The rest of the frame is waited for in poll() */
+		if (ret == 2)
 			break;
+		if (ret == 0) {
+			dbg("All frames have been queued");
+			i->parser.finished = 1;
+			f.offs = 0;
+			f.size = 0;
+		}
+
+		p = input_ptr(i, f.offs, f.size);
+		if (!p || queue_frame(i, n, p, f.size)) {
+			buf_list_put(&i->mfc.out_free, n);
+			return -1;
 		}
+		if (buf_move(&i->mfc.out_buf_state[n], BUF_FREE, BUF_MFC))
+			return -1;
+		input_release(i, f.offs + f.size);
+	}
+
+	if (i->fimc.job < 0 && !queue_empty(&i->fimc.queue)) {
+		i->fimc.job = queue_remove(&i->fimc.queue);
+		if (fimc_process_start(i, i->fimc.job))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Set the events the stream waits for. MFC signals POLLOUT for a processed
+ * OUTPUT buffer and POLLIN for a decoded frame, FIMC POLLIN for a converted
+ * one and the streamed input POLLIN when the awaited data has arrived.
+ * Descriptors with nothing to wait for are ignored. */
+int event_fds(struct instance *i, struct pollfd *fds)
+{
+	memset(fds, 0, EVENT_FDS * sizeof(*fds));
+	fds[0].fd = i->mfc.fd;
+	if (!i->finish && i->mfc.out_free.count < i->mfc.out_buf_cnt)
+		fds[0].events |= POLLOUT;
+	if (!i->finish && i->mfc.cap_buf_queued)
+		fds[0].events |= POLLIN;
+	if (!fds[0].events)
+		fds[0].fd = -1;
+	fds[1].fd = i->fimc.job >= 0 ? i->fimc.fd : -1;
+	fds[1].events = POLLIN;
+	/* A free buffer is left only when the next frame has not arrived */
+	fds[2].fd = -1;
+	if (i->in.event && !i->parser.finished && i->mfc.out_free.count)
+		fds[2].fd = i->in.event;
+	fds[2].events = POLLIN;
+
+	if (fds[0].fd < 0 && fds[1].fd < 0 && fds[2].fd < 0) {
+		err("No buffers are queued in MFC or FIMC");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Pass the buffers returned by MFC and FIMC on to the next queue. At most
+ * one buffer of each kind is handled, so every stream gets its turn. The
+ * data of the streamed input is parsed by event_queue in the next round. */
+int event_handle(struct instance *i, struct pollfd *fds)
+{
+	int finished;
+	int n;
+
+	if ((fds[0].revents | fds[1].revents | fds[2].revents) &
+						(POLLERR | POLLNVAL)) {
+		err("Failed to poll MFC and FIMC");
+		return -1;
+	}
 
-		i->fb.cur_buf = 0;
+	if (fds[0].revents & POLLOUT) {
+		if (dequeue_output(i, &n) || release_output(i, n))
+			return -1;
+	}
 
-		if (i->fb.double_buf) {
-			i->fb.cur_buf++;
-			i->fb.cur_buf %= i->fb.buffers;
+	if (fds[0].revents & POLLIN) {
+		if (dequeue_capture(i, &n, &finished))
+			return -1;
+		i->mfc.cap_buf_queued--;
+		if (finished) {
+			dbg("Finished extracting last frames");
+			i->finish = 1;
+		} else {
+			if (buf_move(&i->mfc.cap_buf_state[n], BUF_MFC,
+								BUF_FIMC))
+				return -1;
+			queue_add(&i->fimc.queue, n);
 		}
+	}
 
-		if (fimc_dec_queue_buf_cap_from_fb(i, i->fb.cur_buf)) {
-			i->error = 1;
-			break;
+	if (fds[1].revents & POLLIN) {
+		if (fimc_process_finish(i, i->fimc.job))
+			return -1;
+		dbg("Processed frame number: %d", i->frames);
+
+		/* The buffer can be filled by MFC again */
+		if (!i->finish) {
+			if (buf_move(&i->mfc.cap_buf_state[i->fimc.job],
+							BUF_FREE, BUF_MFC) ||
+				mfc_dec_queue_buf_cap(i, i->fimc.job))
+				return -1;
+			i->mfc.cap_buf_queued++;
 		}
+		i->fimc.job = -1;
+	}
 
-		if (first_run) {
-			/* Since our fabulous V4L2 framework enforces that at
-			 * least one buffer is queued before switching streaming
-			 * on then we need to add the following code. Otherwise
-			 * it could be ommited and it all would be handled by
-			 * the setup sequence in main.*/
-			first_run = 0;
+	return 0;
+}
+
+/* Decode the streams in a single thread instead of the parser, MFC and
+ * FIMC threads. Frames are extracted and queued while there are free
+ * OUTPUT buffers, then the loop sleeps in poll() until MFC or FIMC returns
+ * a buffer of any stream and passes it on to the next queue. FIMC converts
+ * one frame of each stream at a time. The streams are handled in turns,
+ * starting with a different one in every round. A stream that fails is
+ * stopped, the others go on.
+ * Return value: 0 on success, -1 if any stream has failed */
+int event_loop(struct instance *inst, int count)
+{
+	struct pollfd fds[EVENT_FDS * MAX_STREAMS];
+	struct instance *i;
+	int first = 0;
+	int active;
+	int ret = 0;
+	int k, n;
+
+	for (n = 0; n < count; n++) {
+		inst[n].fimc.job = -1;
+		/* A stream waiting for its input does not hold up the others */
+		if (input_poll_fd(&inst[n]) < 0)
+			return -1;
+	}
+
+	for (;;) {
+		active = 0;
+		for (k = 0; k < count; k++) {
+			i = &inst[(first + k) % count];
+			for (n = 0; n < EVENT_FDS; n++)
+				fds[EVENT_FDS * k + n].fd = -1;
 
-			if (fimc_stream(i, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
-							VIDIOC_STREAMON)) {
+			if (i->error || (i->finish && i->fimc.job < 0 &&
+						queue_empty(&i->fimc.queue)))
+				continue;
+
+			if (event_queue(i) ||
+					event_fds(i, &fds[EVENT_FDS * k])) {
+				err("Decoding of %s has failed", i->in.name);
 				i->error = 1;
-				break;
+				continue;
 			}
-			if (fimc_stream(i, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
-							VIDIOC_STREAMON)) {
+			active++;
+		}
+
+		if (!active)
+			break;
+
+		n = poll(fds, EVENT_FDS * count, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			err("Failed to poll MFC and FIMC");
+			return -1;
+		}
+
+		for (k = 0; k < count; k++) {
+			i = &inst[(first + k) % count];
+			if (i->error)
+				continue;
+
+			if (event_handle(i, &fds[EVENT_FDS * k])) {
+				err("Decoding of %s has failed", i->in.name);
 				i->error = 1;
-				break;
 			}
 		}
 
-		frames++;
+		first = (first + 1) % count;
+	}
 
-		dbg("Processed frame number: %d", frames);
+	for (n = 0; n < count; n++)
+		if (inst[n].error)
+			ret = -1;
 
-		if (fimc_dec_dequeue_buf_cap(i, &tmp)) {
-			i->error = 1;
-			break;
-		}
-		if (fimc_dec_dequeue_buf_out(i, &tmp)) {
-			i->error = 1;
-			break;
-		}
+	return ret;
+}
 
-		if (i->fb.double_buf) {
-			fb_set_virt_y_offset(i, i->fb.height);
-			fb_wait_for_vsync(i);
-		}
+/* Build the frame index of the whole stream before decoding. The start
+ * codes are found by all cores. The index is saved and then loaded as if
+ * it had existed. If this fails the index is built while decoding. */
+int build_index(struct instance *i)
+{
+	double start = now_ms();
 
-		i->mfc.cap_buf_flag[n] = BUF_FREE;
+	/* The start codes are searched for in the whole mapped file */
+	if (i->in.windowed) {
+		dbg("The file is too large, the index is built while decoding");
+		return -1;
+	}
 
-		sem_post(&i->fimc.done);
+	if (pindex_build(&i->index, i->parser.func, i->parser.codec,
+					i->in.p, i->in.size, 0) ||
+			index_save(&i->index, i->in.fd, i->parser.codec)) {
+		index_free(&i->index);
+		return -1;
 	}
+	index_free(&i->index);
 
-	dbg("FIMC thread finished");
+	if (index_load(&i->index, i->in.fd, i->parser.codec))
+		return -1;
+
+	dbg("Built frame index of %d frames in %.1f ms", i->index.count,
+							now_ms() - start);
 	return 0;
 }
 
-int main(int argc, char **argv)
+/* Open the frame buffer and FIMC and setup the FIMC queues. The CAPTURE
+ * queue depends only on the frame buffer. The OUTPUT queue is setup in
+ * advance with the format predicted from the probed header; if MFC reports
+ * a different one it is setup again later. */
+void *setup_thread_func(void *args)
+{
+	struct setup_job *job = args;
+	struct instance *i = job->i;
+	int sizes[MFC_CAP_PLANES];
+	double start = now_ms();
+	int w, h;
+
+	job->ret = -1;
+
+	/* With several streams the frame buffer is opened by the first one */
+	if (!i->fb.shared && fb_open(i, i->fb.name))
+		goto out;
+
+	if (fimc_open(i, i->fimc.name))
+		goto out;
+
+	if (fimc_setup_capture_from_fb(i))
+		goto out;
+
+	if (i->parser.probe.valid) {
+		probe_capture_format(&i->parser.probe, &w, &h, sizes);
+		/* Failure is not fatal, it is tried again with the format
+		 * from MFC */
+		fimc_setup_output(i, w, h, sizes, MFC_MAX_CAP_BUF);
+	}
+
+	job->ret = 0;
+out:
+	job->time = now_ms() - start;
+	return 0;
+}
+
+/* Wait for the setup thread. Return value: 0 if the setup succeeded */
+int join_setup(struct setup_job *job)
+{
+	pthread_join(job->thread, 0);
+	return job->ret;
+}
+
+/* Decode with the parse ahead, parser, MFC and FIMC threads and wait for
+ * them to finish. Return value: 0 on success, -1 if a thread could not be
+ * started */
+int decode_threads(struct instance *i)
 {
-	struct instance inst;
 	pthread_t fimc_thread;
 	pthread_t mfc_thread;
 	pthread_t parser_thread;
+	pthread_t parse_ahead_thread;
+
+	/* Now we're safe to run the threads */
+	dbg("Launching threads");
+
+	if (pthread_create(&parse_ahead_thread, NULL, parse_ahead_thread_func,
+									i))
+		return -1;
+
+	if (pthread_create(&parser_thread, NULL, parser_thread_func, i))
+		return -1;
+
+	if (pthread_create(&mfc_thread, NULL, mfc_thread_func, i))
+		return -1;
+
+	if (pthread_create(&fimc_thread, NULL, fimc_thread_func, i))
+		return -1;
+
+	pthread_join(parse_ahead_thread, 0);
+	pthread_join(parser_thread, 0);
+	pthread_join(mfc_thread, 0);
+	pthread_join(fimc_thread, 0);
+
+	return 0;
+}
+
+/* Open the input, MFC and FIMC of the stream, process its header and set
+ * up the queues, so that decoding can start.
+ * Return value: 0 on success, -1 on error */
+int setup_stream(struct instance *i)
+{
+	struct setup_job setup;
+	double start, t_open, t_header, t_capture, t_fimc;
 	int n;
 
-	printf("V4L2 Codec decoding example application\n");
-	printf("Kamil Debski <k.debski@samsung.com>\n");
-	printf("Copyright 2012 Samsung Electronics Co., Ltd.\n\n");
+	if (queue_init(&i->fimc.queue, MFC_MAX_CAP_BUF) ||
+			queue_init(&i->fimc.done, MFC_MAX_CAP_BUF))
+		return -1;
 
-	if (parse_args(&inst, argc, argv)) {
-		print_usage(argv[0]);
-		return 1;
-	}
+	frame_ring_init(&i->parser.ahead);
 
-	if (queue_init(&inst.fimc.queue, MFC_MAX_CAP_BUF))
-		return 1;
+	start = now_ms();
 
-	if (input_open(&inst, inst.in.name)) {
-		cleanup(&inst);
-		return 1;
-	}
+	if (input_open(i, i->in.name))
+		return -1;
 
-	if (fb_open(&inst, inst.fb.name)) {
-		cleanup(&inst);
-		return 1;
-	}
+	if (mfc_open(i, i->mfc.name))
+		return -1;
 
-	if (fimc_open(&inst, inst.fimc.name)) {
-		cleanup(&inst);
-		return 1;
+	dbg("Successfully opened the input and MFC");
+
+	parse_stream_init(&i->parser.ctx);
+	if (i->parser.stats_name)
+		i->parser.ctx.stats = &i->parser.stats;
+
+	if (i->index.name && i->in.stream) {
+		dbg("The frame index cannot be used with streamed input");
+		i->index.name = NULL;
+		i->parser.seek = 0;
 	}
 
-	if (mfc_open(&inst, inst.mfc.name)) {
-		cleanup(&inst);
-		return 1;
+	if (i->index.name && i->in.mp4.loaded) {
+		dbg("The frame index is not needed for MP4 files");
+		i->index.name = NULL;
 	}
 
-	dbg("Successfully opened all necessary files and devices");
+	if (i->index.name &&
+			index_load(&i->index, i->in.fd, i->parser.codec))
+		build_index(i);
 
-	if (mfc_dec_setup_output(&inst, inst.parser.codec,
-		STREAM_BUUFER_SIZE, STREAM_BUFFER_CNT)) {
-		cleanup(&inst);
-		return 1;
-	}
+	t_open = now_ms();
 
-	parse_stream_init(&inst.parser.ctx);
+	if (extract_and_process_header(i))
+		return -1;
 
-	if (extract_and_process_header(&inst)) {
-		cleanup(&inst);
-		return 1;
-	}
+	t_header = now_ms();
 
-	if (mfc_dec_setup_capture(&inst, RESULT_EXTRA_BUFFER_CNT)) {
-		cleanup(&inst);
-		return 1;
-	}
+	/* MFC processes the header now. Meanwhile the frame buffer and FIMC
+	 * are setup by another thread. */
+	setup.i = i;
+	if (pthread_create(&setup.thread, NULL, setup_thread_func, &setup))
+		return -1;
 
-	if (dequeue_output(&inst, &n)) {
-		cleanup(&inst);
-		return 1;
+	if (mfc_dec_setup_capture(i, RESULT_EXTRA_BUFFER_CNT) ||
+						dequeue_output(i, &n) ||
+						release_output(i, n)) {
+		join_setup(&setup);
+		return -1;
 	}
 
-	if (fimc_setup_output_from_mfc(&inst)) {
-		cleanup(&inst);
-		return 1;
-	}
+	t_capture = now_ms();
 
-	if (fimc_setup_capture_from_fb(&inst)) {
-		cleanup(&inst);
-		return 1;
-	}
+	if (join_setup(&setup))
+		return -1;
 
-	if (fimc_set_crop(&inst, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
-		inst.mfc.cap_crop_w, inst.mfc.cap_crop_h,
-		inst.mfc.cap_crop_left, inst.mfc.cap_crop_top)) {
-		cleanup(&inst);
-		return 1;
+	if (i->parser.probe.valid &&
+		(i->parser.probe.crop_w != i->mfc.cap_crop_w ||
+		i->parser.probe.crop_h != i->mfc.cap_crop_h))
+		dbg("MFC reported %dx%d instead of the probed %dx%d",
+			i->mfc.cap_crop_w, i->mfc.cap_crop_h,
+			i->parser.probe.crop_w, i->parser.probe.crop_h);
+
+	if (i->fimc.out_memory == V4L2_MEMORY_DMABUF &&
+				(mfc_dec_export_capture(i) ||
+				fimc_setup_output_from_mfc(i))) {
+		/* MFC cannot export its buffers or FIMC cannot import them.
+		 * Map them and pass them to FIMC as USERPTR. */
+		dbg("Failed to share the buffers as DMABUF, using USERPTR");
+		i->fimc.out_memory = V4L2_MEMORY_USERPTR;
+		if (mfc_dec_map_capture(i))
+			return -1;
 	}
 
+	if (fimc_setup_output_from_mfc(i))
+		return -1;
+
+	if (fimc_set_crop(i, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+		i->mfc.cap_crop_w, i->mfc.cap_crop_h,
+		i->mfc.cap_crop_left, i->mfc.cap_crop_top))
+		return -1;
+
+	t_fimc = now_ms();
+
+	printf("Startup took %.1f ms: open %.1f ms, header %.1f ms, MFC "
+		"capture setup %.1f ms, FB and FIMC setup %.1f ms (in "
+		"parallel), FIMC OUTPUT setup %.1f ms\n", t_fimc - start,
+		t_open - start, t_header - t_open, t_capture - t_header,
+		setup.time, t_fimc - t_capture);
+	bufsize_report(i);
+
 	dbg("I for one welcome our succesfully setup environment.");
 
 	/* Since our fabulous V4L2 framework enforces that at least one buffer
@@ -461,52 +1190,139 @@ int main(int argc, char **argv)
 	 * following code. Otherwise it could be ommited and it all would be
 	 * handled by the mfc_thread.*/
 
-	for (n = 0 ; n < inst.mfc.cap_buf_cnt; n++) {
+	for (n = 0 ; n < i->mfc.cap_buf_cnt; n++) {
 
-		if (mfc_dec_queue_buf_cap(&inst, n)) {
-			cleanup(&inst);
-			return 1;
-		}
+		if (buf_move(&i->mfc.cap_buf_state[n], BUF_FREE, BUF_MFC) ||
+				mfc_dec_queue_buf_cap(i, n))
+			return -1;
 
-		inst.mfc.cap_buf_flag[n] = BUF_MFC;
-		inst.mfc.cap_buf_queued++;
+		i->mfc.cap_buf_queued++;
 	}
 
-	if (mfc_stream(&inst, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
-							VIDIOC_STREAMON)) {
-		cleanup(&inst);
-		return 1;
+	if (mfc_stream(i, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+							VIDIOC_STREAMON))
+		return -1;
+
+	return 0;
+}
+
+/* Save what has been gathered about the stream while decoding it */
+void finish_stream(struct instance *i)
+{
+	/* The index is complete only if the whole stream has been parsed */
+	if (i->index.name && !i->index.loaded && i->parser.finished &&
+								!i->error)
+		index_save(&i->index, i->in.fd, i->parser.codec);
+
+	if (i->parser.stats_name)
+		stats_write(&i->parser.stats, i->parser.stats_name,
+							i->parser.codec);
+}
+
+/* Print the frame rate of each stream and, with several streams, of all of
+ * them together. It is measured from the start of decoding to the last
+ * frame shown. */
+void report_fps(struct instance *inst, int count)
+{
+	double start = 0, end = 0, t;
+	int frames = 0;
+	int n;
+
+	for (n = 0; n < count; n++) {
+		t = inst[n].frames ? inst[n].end - inst[n].start : 0;
+		printf("%s: %d frames in %.1f ms, %.1f fps%s\n",
+			inst[n].in.name, inst[n].frames, t,
+			t > 0 ? inst[n].frames * 1e3 / t : 0,
+			inst[n].error ? " (failed)" : "");
+
+		frames += inst[n].frames;
+		if (!n || inst[n].start < start)
+			start = inst[n].start;
+		if (inst[n].end > end)
+			end = inst[n].end;
 	}
 
-	sem_init(&inst.fimc.todo, 0, 0);
-	sem_init(&inst.fimc.done, 0, 0);
+	if (count > 1)
+		printf("All %d streams: %d frames in %.1f ms, %.1f fps\n",
+			count, frames, end > start ? end - start : 0,
+			end > start ? frames * 1e3 / (end - start) : 0);
+}
 
-	/* Now we're safe to run the threads */
-	dbg("Launching threads");
+int main(int argc, char **argv)
+{
+	struct instance *inst;
+	int count;
+	int ret = 0;
+	int n;
 
-	if (pthread_create(&parser_thread, NULL, parser_thread_func, &inst)) {
-		cleanup(&inst);
+	inst = calloc(MAX_STREAMS, sizeof(*inst));
+	if (!inst) {
+		err("Failed to allocate the streams");
 		return 1;
 	}
 
-	if (pthread_create(&mfc_thread, NULL, mfc_thread_func, &inst)) {
-		cleanup(&inst);
+	if (parse_args(inst, &count, argc, argv)) {
+		print_usage(argv[0]);
+		free(inst);
 		return 1;
 	}
 
-	if (pthread_create(&fimc_thread, NULL, fimc_thread_func, &inst)) {
-		cleanup(&inst);
+	if (inst[0].parser.stats_name &&
+			stats_open(inst[0].parser.stats_name)) {
+		free(inst);
 		return 1;
 	}
 
+	printf("V4L2 Codec decoding example application\n");
+	printf("Kamil Debski <k.debski@samsung.com>\n");
+	printf("Copyright 2012 Samsung Electronics Co., Ltd.\n\n");
 
-	pthread_join(parser_thread, 0);
-	pthread_join(mfc_thread, 0);
-	pthread_join(fimc_thread, 0);
+	/* Each stream has its own MFC and FIMC context. They share the frame
+	 * buffer opened by the first stream, in which every stream has its
+	 * own tile. */
+	for (n = 0; n < count; n++) {
+		if (count > 1) {
+			printf("Stream %d: %s\n", n, inst[n].in.name);
+			inst[n].fimc.tile = n;
+			inst[n].fimc.tiles = count;
+		}
+		if (n) {
+			inst[n].fb = inst[0].fb;
+			inst[n].fb.shared = 1;
+		}
 
-	dbg("Threads have finished");
+		if (setup_stream(&inst[n])) {
+			count = n + 1;
+			ret = 1;
+			goto out;
+		}
+	}
 
-	cleanup(&inst);
-	return 0;
-}
+	for (n = 0; n < count; n++)
+		inst[n].start = now_ms();
+
+	if (inst[0].event_loop) {
+		dbg("Decoding in a single thread");
+		if (event_loop(inst, count))
+			ret = 1;
+	} else {
+		if (decode_threads(&inst[0])) {
+			ret = 1;
+			goto out;
+		}
+		dbg("Threads have finished");
+		if (inst[0].error)
+			ret = 1;
+	}
+
+	for (n = 0; n < count; n++)
+		finish_stream(&inst[n]);
 
+	report_fps(inst, count);
+
+out:
+	for (n = count - 1; n >= 0; n--)
+		cleanup(&inst[n]);
+	free(inst);
+	return ret;
+}
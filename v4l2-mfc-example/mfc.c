@@ -69,8 +69,20 @@ int mfc_open(struct instance *i, char *name)
 
 
 
+static void mfc_dec_close_exported(struct instance *i)
+{
+	int n;
+
+	for (n = 0; n < i->mfc.cap_buf_exported; n++) {
+		close(i->mfc.cap_buf_fd[n][0]);
+		close(i->mfc.cap_buf_fd[n][1]);
+	}
+	i->mfc.cap_buf_exported = 0;
+}
+
 void mfc_close(struct instance *i)
 {
+	mfc_dec_close_exported(i);
 	close(i->mfc.fd);
 }
 
@@ -105,9 +117,16 @@ int mfc_dec_setup_output(struct instance *i, unsigned long codec,
 	memzero(reqbuf);
 	reqbuf.count = count;
 	reqbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-	reqbuf.memory = V4L2_MEMORY_MMAP;
+	reqbuf.memory = i->mfc.out_memory;
 
 	ret = ioctl(i->mfc.fd, VIDIOC_REQBUFS, &reqbuf);
+	if (ret != 0 && i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		dbg("USERPTR not supported on OUTPUT of MFC, using MMAP");
+		i->mfc.out_memory = V4L2_MEMORY_MMAP;
+		reqbuf.count = count;
+		reqbuf.memory = V4L2_MEMORY_MMAP;
+		ret = ioctl(i->mfc.fd, VIDIOC_REQBUFS, &reqbuf);
+	}
 	if (ret != 0) {
 		err("REQBUFS failed on OUTPUT queue of MFC");
 		return -1;
@@ -117,6 +136,16 @@ int mfc_dec_setup_output(struct instance *i, unsigned long codec,
 	dbg("Number of MFC OUTPUT buffers is %d (requested %d)",
 					 i->mfc.out_buf_cnt, count);
 
+	if (i->mfc.out_memory == V4L2_MEMORY_USERPTR) {
+		/* The stream is queued straight from the input file, there
+		 * is nothing to map */
+		for (n = 0; n < i->mfc.out_buf_cnt; n++)
+			i->mfc.out_buf_state[n] = BUF_FREE;
+		buf_list_init(&i->mfc.out_free, i->mfc.out_buf_cnt);
+		dbg("Using USERPTR for MFC OUTPUT buffers");
+		return 0;
+	}
+
 	for (n = 0; n < i->mfc.out_buf_cnt; n++) {
 		memzero(buf);
 		buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
@@ -142,8 +171,9 @@ int mfc_dec_setup_output(struct instance *i, unsigned long codec,
 			return -1;
 		}
 
-		i->mfc.out_buf_flag[n] = 0;
+		i->mfc.out_buf_state[n] = BUF_FREE;
 	}
+	buf_list_init(&i->mfc.out_free, i->mfc.out_buf_cnt);
 
 	dbg("Succesfully mmapped %d MFC OUTPUT buffers", n);
 
@@ -180,6 +210,64 @@ int mfc_dec_queue_buf(struct instance *i, int n, int l1, int l2, int type,
 	return 0;
 }
 
+int mfc_dec_release_output(struct instance *i)
+{
+	struct v4l2_requestbuffers reqbuf;
+	int n;
+
+	if (i->mfc.out_memory == V4L2_MEMORY_MMAP)
+		for (n = 0; n < i->mfc.out_buf_cnt; n++)
+			munmap(i->mfc.out_buf_addr[n], i->mfc.out_buf_size);
+
+	memzero(reqbuf);
+	reqbuf.count = 0;
+	reqbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	reqbuf.memory = i->mfc.out_memory;
+
+	if (ioctl(i->mfc.fd, VIDIOC_REQBUFS, &reqbuf)) {
+		err("Failed to release OUTPUT buffers of MFC");
+		return -1;
+	}
+	i->mfc.out_buf_cnt = 0;
+
+	return 0;
+}
+
+int mfc_dec_queue_buf_out_userptr(struct instance *i, int n, char *p,
+							int size, int length)
+{
+	struct v4l2_buffer qbuf;
+	struct v4l2_plane planes[MFC_OUT_PLANES];
+	int ret;
+
+	if (n >= i->mfc.out_buf_cnt) {
+		err("Tried to queue a non exisiting buffer");
+		return -1;
+	}
+
+	memzero(qbuf);
+	memzero(planes);
+	qbuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	qbuf.memory = V4L2_MEMORY_USERPTR;
+	qbuf.index = n;
+	qbuf.m.planes = planes;
+	qbuf.length = MFC_OUT_PLANES;
+	qbuf.m.planes[0].bytesused = size;
+	qbuf.m.planes[0].length = length;
+	qbuf.m.planes[0].m.userptr = (unsigned long)p;
+
+	ret = ioctl(i->mfc.fd, VIDIOC_QBUF, &qbuf);
+
+	if (ret) {
+		err("Failed to queue user buffer (index=%d) on OUTPUT", n);
+		return -1;
+	}
+
+	dbg("Queued user buffer on OUTPUT queue with index %d", n);
+
+	return 0;
+}
+
 int mfc_dec_queue_buf_out(struct instance *i, int n, int length)
 {
 	if (n >= i->mfc.out_buf_cnt) {
@@ -242,8 +330,6 @@ int mfc_dec_setup_capture(struct instance *i, int extra_buf)
 {
 	struct v4l2_format fmt;
 	struct v4l2_requestbuffers reqbuf;
-	struct v4l2_buffer buf;
-	struct v4l2_plane planes[MFC_CAP_PLANES];
 	struct v4l2_control ctrl;
 	struct v4l2_crop crop;
 	int ret;
@@ -271,6 +357,8 @@ int mfc_dec_setup_capture(struct instance *i, int extra_buf)
 	i->mfc.cap_buf_cnt = ctrl.value + extra_buf;
 	i->mfc.cap_buf_cnt_min = ctrl.value;
 	i->mfc.cap_buf_queued = 0;
+	for (n = 0; n < MFC_MAX_CAP_BUF; n++)
+		i->mfc.cap_buf_state[n] = BUF_FREE;
 
 	dbg("MFC buffer parameters: %dx%d plane[0]=%d plane[1]=%d",
 		fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height,
@@ -308,6 +396,20 @@ int mfc_dec_setup_capture(struct instance *i, int extra_buf)
 
 	i->mfc.cap_buf_cnt = reqbuf.count;
 
+	/* Buffers passed to FIMC as DMABUF are not accessed by the CPU */
+	if (i->fimc.out_memory == V4L2_MEMORY_DMABUF)
+		return 0;
+
+	return mfc_dec_map_capture(i);
+}
+
+int mfc_dec_map_capture(struct instance *i)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane planes[MFC_CAP_PLANES];
+	int ret;
+	int n;
+
 	for (n = 0; n < i->mfc.cap_buf_cnt; n++) {
 		memzero(buf);
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
@@ -344,3 +446,34 @@ int mfc_dec_setup_capture(struct instance *i, int extra_buf)
 	return 0;
 }
 
+int mfc_dec_export_capture(struct instance *i)
+{
+	struct v4l2_exportbuffer eb;
+	int n, p;
+
+	for (n = 0; n < i->mfc.cap_buf_cnt; n++) {
+		for (p = 0; p < MFC_CAP_PLANES; p++) {
+			memzero(eb);
+			eb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+			eb.index = n;
+			eb.plane = p;
+			eb.flags = O_CLOEXEC;
+
+			if (ioctl(i->mfc.fd, VIDIOC_EXPBUF, &eb)) {
+				dbg("EXPBUF failed on CAPTURE buffer %d of MFC",
+									n);
+				if (p)
+					close(i->mfc.cap_buf_fd[n][0]);
+				mfc_dec_close_exported(i);
+				return -1;
+			}
+			i->mfc.cap_buf_fd[n][p] = eb.fd;
+		}
+		i->mfc.cap_buf_exported = n + 1;
+	}
+
+	dbg("Succesfully exported %d MFC CAPTURE buffers", n);
+
+	return 0;
+}
+
@@ -34,8 +34,15 @@ void	mfc_close(struct instance *i);
  * The count is the number of the stream buffers to allocate. */
 int	mfc_dec_setup_output(struct instance *i, unsigned long codec,
 					unsigned int size, int count);
+/* Free the buffers of the OUTPUT queue, so it can be setup again */
+int	mfc_dec_release_output(struct instance *i);
 /* Queue OUTPUT buffer */
 int	mfc_dec_queue_buf_out(struct instance *i, int n, int length);
+/* Queue OUTPUT buffer that points to the user memory p of the given length,
+ * size bytes of which contain the stream. This is used when the OUTPUT
+ * queue has been setup with USERPTR. */
+int	mfc_dec_queue_buf_out_userptr(struct instance *i, int n, char *p,
+						int size, int length);
 /* Queue CAPTURE buffer */
 int	mfc_dec_queue_buf_cap(struct instance *i, int n);
 /* Control MFC streaming */
@@ -45,6 +52,12 @@ int	mfc_stream(struct instance *i, enum v4l2_buf_type type, int status);
  * by MFC. The final number of buffers allocated is stored in the instance
  * structure. */
 int	mfc_dec_setup_capture(struct instance *i, int extra_buf);
+/* Map the CAPTURE buffers, so that FIMC can take them as USERPTR. This is
+ * done by mfc_dec_setup_capture unless they are passed as DMABUF. */
+int	mfc_dec_map_capture(struct instance *i);
+/* Export the planes of the CAPTURE buffers as DMABUF for FIMC. They are
+ * closed with the device. */
+int	mfc_dec_export_capture(struct instance *i);
 /* Dequeue a buffer, the structure *buf is used to return the parameters of the
  * dequeued buffer. */
 int	mfc_dec_dequeue_buf(struct instance *i, struct v4l2_buffer *buf);
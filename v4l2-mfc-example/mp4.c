@@ -0,0 +1,573 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * MP4 demultiplexer
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "mp4.h"
+#include "parser.h"
+
+static uint32_t be32(const unsigned char *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t be64(const unsigned char *p)
+{
+	return ((uint64_t)be32(p) << 32) | be32(p + 4);
+}
+
+static uint32_t be_n(const unsigned char *p, int n)
+{
+	uint32_t v = 0;
+
+	while (n--)
+		v = (v << 8) | *p++;
+	return v;
+}
+
+/* Find the next box of the type in [*p, end). On return *p points after
+ * the box. Returns the payload of the box and its size in *size or NULL if
+ * there is no such box. */
+static const unsigned char *mp4_find(const unsigned char **p,
+		const unsigned char *end, const char *type, uint64_t *size)
+{
+	const unsigned char *b = *p;
+	uint64_t box, hdr;
+
+	while (end - b >= 8) {
+		box = be32(b);
+		hdr = 8;
+		if (box == 1) {
+			if (end - b < 16)
+				break;
+			box = be64(b + 8);
+			hdr = 16;
+		} else if (box == 0) {
+			box = end - b;
+		}
+		if (box < hdr || box > end - b)
+			break;
+		if (memcmp(b + 4, type, 4) == 0) {
+			*p = b + box;
+			*size = box - hdr;
+			return b + hdr;
+		}
+		b += box;
+	}
+
+	*p = end;
+	return NULL;
+}
+
+/* Find the box at the path of nested box types, e.g. "mdiaminf" */
+static const unsigned char *mp4_path(const unsigned char *p, uint64_t size,
+					const char *path, uint64_t *box_size)
+{
+	const unsigned char *end;
+
+	for (; *path; path += 4) {
+		end = p + size;
+		p = mp4_find(&p, end, path, &size);
+		if (!p)
+			return NULL;
+	}
+
+	*box_size = size;
+	return p;
+}
+
+int mp4_probe(const char *p, unsigned long size)
+{
+	if (size < 8)
+		return 0;
+	return memcmp(p + 4, "ftyp", 4) == 0 || memcmp(p + 4, "moov", 4) == 0;
+}
+
+/* Append a NAL unit to the header, with a length prefix */
+static int mp4_header_add(struct mp4_demux *m, const unsigned char *nal,
+							int len, int *alloc)
+{
+	char *h;
+	int n;
+
+	if (m->length_size < 4 && len >> (8 * m->length_size))
+		return -1;
+
+	if (m->header_size + m->length_size + len > *alloc) {
+		*alloc = 2 * (m->header_size + m->length_size + len);
+		h = realloc(m->header, *alloc);
+		if (!h)
+			return -1;
+		m->header = h;
+	}
+
+	for (n = m->length_size - 1; n >= 0; n--)
+		m->header[m->header_size++] = len >> (8 * n);
+	memcpy(m->header + m->header_size, nal, len);
+	m->header_size += len;
+
+	return 0;
+}
+
+/* Get the parameter sets from the avcC box */
+static int mp4_parse_avcc(struct mp4_demux *m, const unsigned char *p,
+								uint64_t size)
+{
+	const unsigned char *end = p + size;
+	int alloc = 0;
+	int cnt, len, n;
+
+	if (size < 7)
+		return -1;
+	m->length_size = (p[4] & 0x3) + 1;
+	p += 5;
+
+	/* SPS and then PPS */
+	for (n = 0; n < 2; n++) {
+		cnt = *p++ & (n == 0 ? 0x1F : 0xFF);
+		while (cnt--) {
+			if (end - p < 2)
+				return -1;
+			len = (p[0] << 8) | p[1];
+			p += 2;
+			if (end - p < len || mp4_header_add(m, p, len, &alloc))
+				return -1;
+			p += len;
+		}
+		if (n == 0 && p >= end)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Get the parameter sets from the hvcC box */
+static int mp4_parse_hvcc(struct mp4_demux *m, const unsigned char *p,
+								uint64_t size)
+{
+	const unsigned char *end = p + size;
+	int alloc = 0;
+	int arrays, cnt, len;
+
+	if (size < 23)
+		return -1;
+	m->length_size = (p[21] & 0x3) + 1;
+	arrays = p[22];
+	p += 23;
+
+	while (arrays--) {
+		if (end - p < 3)
+			return -1;
+		cnt = (p[1] << 8) | p[2];
+		p += 3;
+		while (cnt--) {
+			if (end - p < 2)
+				return -1;
+			len = (p[0] << 8) | p[1];
+			p += 2;
+			if (end - p < len || mp4_header_add(m, p, len, &alloc))
+				return -1;
+			p += len;
+		}
+	}
+
+	return 0;
+}
+
+/* Read the tag and length of an MPEG-4 descriptor */
+static const unsigned char *mp4_descr(const unsigned char *p,
+				const unsigned char *end, int tag, int *len)
+{
+	int n;
+
+	if (p >= end || *p++ != tag)
+		return NULL;
+
+	*len = 0;
+	for (n = 0; n < 4 && p < end; n++) {
+		*len = (*len << 7) | (*p & 0x7F);
+		if (!(*p++ & 0x80))
+			break;
+	}
+
+	if (*len > end - p)
+		return NULL;
+	return p;
+}
+
+/* Check the object type in the esds box and get the decoder specific info,
+ * which is the stream header */
+static int mp4_parse_esds(struct mp4_demux *m, const unsigned char *p,
+					uint64_t size, unsigned long codec)
+{
+	const unsigned char *end = p + size;
+	int len, oti, flags;
+
+	/* Version and flags */
+	p = mp4_descr(p + 4, end, 0x03, &len);
+	if (!p || len < 3)
+		return -1;
+	end = p + len;
+	flags = p[2];
+	p += 3;
+	if (flags & 0x80)
+		p += 2;
+	if (flags & 0x40 && p < end)
+		p += 1 + *p;
+	if (flags & 0x20)
+		p += 2;
+
+	p = mp4_descr(p, end, 0x04, &len);
+	if (!p || len < 13)
+		return -1;
+	oti = p[0];
+
+	switch (codec) {
+	case V4L2_PIX_FMT_MPEG4:
+	case V4L2_PIX_FMT_XVID:
+		if (oti != 0x20)
+			return -1;
+		break;
+	case V4L2_PIX_FMT_MPEG2:
+		if (oti < 0x60 || oti > 0x65)
+			return -1;
+		break;
+	case V4L2_PIX_FMT_MPEG1:
+		if (oti != 0x6A)
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+
+	end = p + len;
+	p = mp4_descr(p + 13, end, 0x05, &len);
+	if (p && len > 0) {
+		m->header = malloc(len);
+		if (!m->header)
+			return -1;
+		memcpy(m->header, p, len);
+		m->header_size = len;
+	}
+
+	return 0;
+}
+
+/* Check the sample entry of the track and get the stream header */
+static int mp4_parse_stsd(struct mp4_demux *m, const unsigned char *p,
+					uint64_t size, unsigned long codec)
+{
+	const unsigned char *cfg, *end;
+	uint64_t cfg_size;
+
+	/* Version, flags and entry_count are followed by the first sample
+	 * entry. Its boxes follow the 78 bytes of the VisualSampleEntry. */
+	if (size < 8 + 8 + 78)
+		return -1;
+	p += 8;
+	end = p + be32(p);
+	if (end > p + size - 8 || end < p + 8 + 78)
+		return -1;
+	cfg = p + 8 + 78;
+
+	switch (codec) {
+	case V4L2_PIX_FMT_H264:
+		if (memcmp(p + 4, "avc1", 4) && memcmp(p + 4, "avc3", 4))
+			return -1;
+		cfg = mp4_find(&cfg, end, "avcC", &cfg_size);
+		if (!cfg)
+			return -1;
+		return mp4_parse_avcc(m, cfg, cfg_size);
+	case V4L2_PIX_FMT_HEVC:
+		if (memcmp(p + 4, "hvc1", 4) && memcmp(p + 4, "hev1", 4))
+			return -1;
+		cfg = mp4_find(&cfg, end, "hvcC", &cfg_size);
+		if (!cfg)
+			return -1;
+		return mp4_parse_hvcc(m, cfg, cfg_size);
+	case V4L2_PIX_FMT_H263:
+		/* There is no stream header in the sample entry */
+		return memcmp(p + 4, "s263", 4) ? -1 : 0;
+	}
+
+	if (memcmp(p + 4, "mp4v", 4))
+		return -1;
+	cfg = mp4_find(&cfg, end, "esds", &cfg_size);
+	if (!cfg)
+		return -1;
+	return mp4_parse_esds(m, cfg, cfg_size, codec);
+}
+
+/* Get the sample tables of the track */
+static int mp4_parse_stbl(struct mp4_demux *m, const unsigned char *stbl,
+								uint64_t size)
+{
+	const unsigned char *p;
+	uint64_t box;
+
+	p = mp4_path(stbl, size, "stsz", &box);
+	if (!p || box < 12)
+		return -1;
+	m->stsz = p;
+	m->fixed_size = be32(p + 4);
+	m->sample_count = be32(p + 8);
+	if (!m->fixed_size && (box - 12) / 4 < m->sample_count)
+		return -1;
+
+	p = mp4_path(stbl, size, "stsc", &box);
+	if (!p || box < 8)
+		return -1;
+	m->stsc = p;
+	m->stsc_count = be32(p + 4);
+	if (m->stsc_count < 1 || (box - 8) / 12 < m->stsc_count)
+		return -1;
+
+	p = mp4_path(stbl, size, "stco", &box);
+	if (!p) {
+		p = mp4_path(stbl, size, "co64", &box);
+		m->co64 = 1;
+	}
+	if (!p || box < 8)
+		return -1;
+	m->stco = p;
+	m->chunk_count = be32(p + 4);
+	if ((box - 8) / (m->co64 ? 8 : 4) < m->chunk_count)
+		return -1;
+
+	/* Without the stss box all samples are key frames */
+	p = mp4_path(stbl, size, "stss", &box);
+	if (p) {
+		if (box < 8)
+			return -1;
+		m->stss = p;
+		m->stss_count = be32(p + 4);
+		if ((box - 8) / 4 < m->stss_count)
+			return -1;
+	}
+
+	return 0;
+}
+
+int mp4_open(struct mp4_demux *m, const char *p, unsigned long size,
+							unsigned long codec)
+{
+	const unsigned char *moov, *trak, *end, *box;
+	uint64_t moov_size, trak_size, box_size;
+
+	memzero(*m);
+	m->base = (const unsigned char *)p;
+	m->size = size;
+
+	box = m->base;
+	moov = mp4_find(&box, m->base + size, "moov", &moov_size);
+	if (!moov) {
+		err("No moov box in the MP4 file");
+		return -1;
+	}
+
+	/* Use the first video track of the codec */
+	end = moov + moov_size;
+	while ((trak = mp4_find(&moov, end, "trak", &trak_size))) {
+		box = mp4_path(trak, trak_size, "mdiahdlr", &box_size);
+		if (!box || box_size < 12 || memcmp(box + 8, "vide", 4))
+			continue;
+
+		box = mp4_path(trak, trak_size, "mdiaminfstblstsd", &box_size);
+		if (!box || mp4_parse_stsd(m, box, box_size, codec)) {
+			free(m->header);
+			m->header = NULL;
+			m->header_size = 0;
+			m->length_size = 0;
+			continue;
+		}
+
+		box = mp4_path(trak, trak_size, "mdiaminfstbl", &box_size);
+		if (!box || mp4_parse_stbl(m, box, box_size)) {
+			err("Invalid sample tables in the MP4 file");
+			mp4_close(m);
+			return -1;
+		}
+
+		if (m->sample_count == 0) {
+			err("No samples in the moov box, fragmented MP4 files "
+							"are not supported");
+			mp4_close(m);
+			return -1;
+		}
+
+		dbg("Found MP4 video track with %d samples", m->sample_count);
+		m->loaded = 1;
+		return 0;
+	}
+
+	err("No video track of the chosen codec in the MP4 file");
+	mp4_close(m);
+	return -1;
+}
+
+int mp4_next(struct mp4_demux *m, uint64_t *offs, int *size, int *flags)
+{
+	const unsigned char *e;
+
+	if (m->sample >= m->sample_count)
+		return -1;
+
+	if (m->in_chunk == 0) {
+		if (m->chunk >= m->chunk_count) {
+			err("Invalid sample tables in the MP4 file");
+			return -1;
+		}
+		/* stsc lists the first chunk (counted from 1) of each run of
+		 * chunks with the same number of samples */
+		while (m->stsc_idx + 1 < m->stsc_count &&
+			be32(m->stsc + 8 + 12 * (m->stsc_idx + 1)) <= m->chunk + 1)
+			m->stsc_idx++;
+		m->per_chunk = be32(m->stsc + 8 + 12 * m->stsc_idx + 4);
+		if (m->per_chunk <= 0) {
+			err("Invalid sample tables in the MP4 file");
+			return -1;
+		}
+		if (m->co64)
+			m->offs = be64(m->stco + 8 + 8 * m->chunk);
+		else
+			m->offs = be32(m->stco + 8 + 4 * m->chunk);
+	}
+
+	*offs = m->offs;
+	*size = m->fixed_size ? m->fixed_size :
+				be32(m->stsz + 12 + 4 * m->sample);
+	if (*size < 0 || *offs + *size > m->size) {
+		err("MP4 sample %d is outside of the file", m->sample);
+		return -1;
+	}
+
+	*flags = PARSER_FRAME_PIC;
+	if (m->stss) {
+		/* The key frames are listed in ascending order */
+		e = m->stss + 8 + 4 * m->stss_idx;
+		while (m->stss_idx < m->stss_count && be32(e) < m->sample + 1) {
+			m->stss_idx++;
+			e += 4;
+		}
+		if (m->stss_idx < m->stss_count && be32(e) == m->sample + 1)
+			*flags |= PARSER_FRAME_KEY;
+	} else {
+		*flags |= PARSER_FRAME_KEY;
+	}
+
+	m->offs += *size;
+	m->sample++;
+	if (++m->in_chunk == m->per_chunk) {
+		m->in_chunk = 0;
+		m->chunk++;
+	}
+
+	return 0;
+}
+
+int mp4_seek_key(struct mp4_demux *m, int n)
+{
+	uint64_t offs;
+	int size, flags;
+	int key = n;
+	int k;
+
+	if (n >= m->sample_count)
+		n = m->sample_count - 1;
+
+	if (m->stss) {
+		key = -1;
+		for (k = 0; k < m->stss_count; k++) {
+			if (be32(m->stss + 8 + 4 * k) > n + 1)
+				break;
+			key = be32(m->stss + 8 + 4 * k) - 1;
+		}
+		if (key < 0)
+			return -1;
+	}
+
+	/* Walk the tables up to the key frame */
+	m->sample = 0;
+	m->chunk = 0;
+	m->in_chunk = 0;
+	m->stsc_idx = 0;
+	m->stss_idx = 0;
+	for (k = 0; k < key; k++)
+		if (mp4_next(m, &offs, &size, &flags))
+			return -1;
+
+	return key;
+}
+
+int mp4_copy(struct mp4_demux *m, char *dst, int dst_size, const char *p,
+								int size)
+{
+	const unsigned char *u = (const unsigned char *)p;
+	int out = 0;
+	uint32_t len;
+
+	if (!m->length_size) {
+		if (size > dst_size) {
+			err("Output buffer too small for current frame");
+			return -1;
+		}
+		memcpy(dst, p, size);
+		return size;
+	}
+
+	while (size > 0) {
+		if (size < m->length_size) {
+			err("Invalid NAL unit length in the MP4 sample");
+			return -1;
+		}
+		len = be_n(u, m->length_size);
+		u += m->length_size;
+		size -= m->length_size;
+		if (len > size) {
+			err("Invalid NAL unit length in the MP4 sample");
+			return -1;
+		}
+		if (out + 4 + len > dst_size) {
+			err("Output buffer too small for current frame");
+			return -1;
+		}
+		dst[out++] = 0;
+		dst[out++] = 0;
+		dst[out++] = 0;
+		dst[out++] = 1;
+		memcpy(dst + out, u, len);
+		out += len;
+		u += len;
+		size -= len;
+	}
+
+	return out;
+}
+
+void mp4_close(struct mp4_demux *m)
+{
+	free(m->header);
+	m->header = NULL;
+	m->loaded = 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * MP4 demultiplexer header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_MP4_H
+#define INCLUDE_MP4_H
+
+#include <stdint.h>
+
+/* Video track of an MP4 (ISO base media) file. The samples are located
+ * using the sample tables of the track, the stream is not parsed. */
+struct mp4_demux {
+	/* Set when the file has been recognised and the track found */
+	int loaded;
+	const unsigned char *base;
+	unsigned long size;
+
+	/* Sample tables, they point to the mmapped file */
+	const unsigned char *stsz;
+	const unsigned char *stsc;
+	const unsigned char *stco;
+	const unsigned char *stss;
+	int co64;
+	int sample_count;
+	uint32_t fixed_size;
+	int stsc_count;
+	int chunk_count;
+	int stss_count;
+
+	/* Size of the NAL unit length prefix of the H264 and HEVC samples,
+	 * 0 if the samples are copied as they are */
+	int length_size;
+	/* Stream header from the sample description, NULL if there is none.
+	 * It is stored in the same form as the samples. */
+	char *header;
+	int header_size;
+
+	/* Position of the next sample */
+	int sample;
+	int chunk;
+	int in_chunk;
+	int per_chunk;
+	int stsc_idx;
+	int stss_idx;
+	uint64_t offs;
+};
+
+/* Check if the data is an MP4 file */
+int	mp4_probe(const char *p, unsigned long size);
+/* Find the video track of the codec and prepare its sample tables */
+int	mp4_open(struct mp4_demux *m, const char *p, unsigned long size,
+							unsigned long codec);
+/* Get the next sample. Returns 0 and its offset, size and PARSER_FRAME_*
+ * flags or -1 if there are no more samples. */
+int	mp4_next(struct mp4_demux *m, uint64_t *offs, int *size, int *flags);
+/* Continue from the last key frame that is not after the sample n.
+ * Returns the number of the sample or -1 on error. */
+int	mp4_seek_key(struct mp4_demux *m, int n);
+/* Copy the sample (or the header) to dst, replacing the NAL unit length
+ * prefixes by start codes. Returns the size of the copy or -1 if it does
+ * not fit. */
+int	mp4_copy(struct mp4_demux *m, char *dst, int dst_size, const char *p,
+								int size);
+/* Free the demultiplexer */
+void	mp4_close(struct mp4_demux *m);
+
+#endif /* INCLUDE_MP4_H */
@@ -20,8 +20,11 @@
  *
  */
 
+#include "bits.h"
 #include "common.h"
 #include "parser.h"
+#include "scan.h"
+#include "stats.h"
 #include <string.h>
 
 int parse_stream_init(struct mfc_parser_context *ctx)
@@ -34,15 +37,130 @@ int parse_stream_init(struct mfc_parser_context *ctx)
 	return 0;
 }
 
-int parse_mpeg4_stream(
+void parse_stream_set_codes(struct mfc_parser_context *ctx,
+		const char *base, const uint64_t *codes, int count)
+{
+	ctx->codes_base = base;
+	ctx->codes = codes;
+	ctx->codes_count = count;
+}
+
+/* Number of bytes that can be skipped in the NO_CODE state. Without the
+ * list of start codes it is the distance to the next zero pair. With the
+ * list the zero pairs that do not begin a start code are skipped too, as
+ * the state machine returns to NO_CODE after them anyway. */
+static int parse_skip(struct mfc_parser_context *ctx, char *in, int in_size)
+{
+	uint64_t offs;
+	int lo, hi, mid;
+
+	if (!ctx->codes)
+		return scan_zero_pair(in, in_size);
+
+	/* In a run of zeros that began before in the code may begin here */
+	if (in_size > 1 && in[0] == 0 && in[1] == 0)
+		return 0;
+
+	offs = in - ctx->codes_base;
+	lo = 0;
+	hi = ctx->codes_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ctx->codes[mid] < offs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == ctx->codes_count || ctx->codes[lo] - offs >= in_size - 1)
+		return in_size - 1;
+	return ctx->codes[lo] - offs;
+}
+
+/* Count a unit found in the stream: the NAL unit type in H264 and HEVC and
+ * the start code value in the other codecs */
+static inline void parse_count_unit(struct mfc_parser_context *ctx, int code)
+{
+	if (ctx->stats)
+		ctx->stats->units[code & (STATS_UNIT_TYPES - 1)]++;
+}
+
+/* Number of bytes of the stream available from in. In the span mode they
+ * do not have to be in memory, see avail in the context. */
+static int parse_avail(struct mfc_parser_context *ctx, int in_size, char *out)
+{
+	if (out || ctx->avail < in_size)
+		return in_size;
+	return ctx->avail;
+}
+
+/* Account a classified tag to the frame that is being extracted. Only the
+ * first picture of the frame determines its type. */
+static void parse_tag_add(struct mfc_parser_context *ctx, int flags, int type)
+{
+	if (flags & PARSER_FRAME_PIC) {
+		if (ctx->cur_flags & PARSER_FRAME_PIC)
+			return;
+		ctx->cur_type = type;
+		ctx->cur_coding = ctx->pic_coding;
+	}
+	ctx->cur_flags |= flags;
+}
+
+/* Return the description of the extracted frame. If it is complete then
+ * the tag that has ended it becomes the first tag of the next frame. */
+static void parse_tag_finish(struct mfc_parser_context *ctx, char got_end,
+						int tag_flags, int tag_type)
+{
+	ctx->frame_flags = ctx->cur_flags;
+	ctx->frame_type = ctx->cur_type;
+	ctx->frame_coding = ctx->cur_coding;
+	ctx->picture_structure = ctx->cur_structure;
+	ctx->top_field_first = ctx->cur_tff;
+
+	if (got_end) {
+		ctx->cur_flags = 0;
+		ctx->cur_type = 0;
+		ctx->cur_coding = PARSER_CODING_UNKNOWN;
+		parse_tag_add(ctx, tag_flags, tag_type);
+	}
+}
+
+/* Codec specific part of the parsers of streams with start codes. The
+ * classifiers are called for the unit that follows a start code (and for
+ * the H263 short header) with size bytes available from in. They return
+ * PARSER_FRAME_PIC, with PARSER_FRAME_KEY if it is a key picture, for the
+ * first unit of a picture and PARSER_FRAME_HEAD for the units that begin a
+ * new frame when they follow a picture. Other units belong to the recent
+ * frame and 0 is returned. The codec specific type of the picture is
+ * returned in type. */
+struct parse_codec {
+	/* Set if 00 00 00 01 is a four byte start code, as the zero_byte
+	 * of H264 and HEVC belongs to the following unit */
+	int zero_byte;
+	int (*unit)(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type);
+	/* Called for 00 00 followed by a byte other than 00 and 01, NULL if
+	 * the codec has no short header */
+	int (*short_header)(struct mfc_parser_context *ctx, char *in,
+				int size, char get_head, int *type);
+};
+
+/* Common core of the parsers of streams with start codes. It is inlined
+ * in every parser together with its classifiers, see parse_mpeg4_stream
+ * for the arguments. */
+static inline __attribute__((always_inline)) int parse_codes(
 	struct mfc_parser_context *ctx,
 	char* in, int in_size, char* out, int out_size,
-	int *consumed, int *frame_size, char get_head)
+	int *consumed, int *frame_size, char get_head,
+	const struct parse_codec *codec)
 {
 	char *in_orig;
-	char tmp;
 	char frame_finished;
 	int frame_length;
+	int tag_flags = 0;
+	int tag_type = 0;
+	int skip;
 
 	in_orig = in;
 
@@ -50,62 +168,74 @@ int parse_mpeg4_stream(
 
 	frame_finished = 0;
 
-	while (in_size-- > 0) {
+	while (in_size > 0) {
+		/* Nothing happens in the NO_CODE state until a zero pair is
+		 * found, so jump straight to the next candidate */
+		if (ctx->state == PARSER_NO_CODE && !scan_bytewise) {
+			skip = parse_skip(ctx, in, in_size);
+			in += skip;
+			*consumed += skip;
+			in_size -= skip;
+		}
+		in_size--;
+		tag_flags = 0;
+
 		switch (ctx->state) {
-		case MPEG4_PARSER_NO_CODE:
+		case PARSER_NO_CODE:
 			if (*in == 0x0) {
-				ctx->state = MPEG4_PARSER_CODE_0x1;
+				ctx->state = PARSER_CODE_0x1;
 				ctx->tmp_code_start = *consumed;
 			}
 			break;
-		case MPEG4_PARSER_CODE_0x1:
+		case PARSER_CODE_0x1:
 			if (*in == 0x0)
-				ctx->state = MPEG4_PARSER_CODE_0x2;
+				ctx->state = PARSER_CODE_0x2;
 			else
-				ctx->state = MPEG4_PARSER_NO_CODE;
+				ctx->state = PARSER_NO_CODE;
 			break;
-		case MPEG4_PARSER_CODE_0x2:
+		case PARSER_CODE_0x2:
 			if (*in == 0x1) {
-				ctx->state = MPEG4_PARSER_CODE_1x1;
-			} else if ((*in & 0xFC) == 0x80) {
-				/* Short header */
-				ctx->state = MPEG4_PARSER_NO_CODE;
-				/* Ignore the short header if the current hasn't
-				 * been started with a short header. */
-
-				if (get_head && !ctx->short_header) {
-					ctx->last_tag = MPEG4_TAG_HEAD;
-					ctx->headers_count++;
-					ctx->short_header = 1;
-				} else if (!ctx->seek_end ||
-					(ctx->seek_end && ctx->short_header)) {
-					ctx->last_tag = MPEG4_TAG_VOP;
-					ctx->main_count++;
-					ctx->short_header = 1;
-				}
+				ctx->state = PARSER_CODE_1x1;
 			} else if (*in == 0x0) {
-				ctx->tmp_code_start++;
+				/* We still have two zeroes */
+				if (codec->zero_byte)
+					ctx->state = PARSER_CODE_0x3;
+				else
+					ctx->tmp_code_start++;
 			} else {
-				ctx->state = MPEG4_PARSER_NO_CODE;
+				ctx->state = PARSER_NO_CODE;
+				if (codec->short_header)
+					tag_flags = codec->short_header(ctx, in,
+						in_size + 1 + ctx->lookahead,
+						get_head, &tag_type);
 			}
 			break;
-		case MPEG4_PARSER_CODE_1x1:
-			tmp = *in & 0xF0;
-			if (tmp == 0x00 || tmp == 0x01 || tmp == 0x20 ||
-				*in == 0xb0 || *in == 0xb2 || *in == 0xb3 ||
-				*in == 0xb5) {
-				ctx->state = MPEG4_PARSER_NO_CODE;
-				ctx->last_tag = MPEG4_TAG_HEAD;
-				ctx->headers_count++;
-			} else if (*in == 0xb6) {
-				ctx->state = MPEG4_PARSER_NO_CODE;
-				ctx->last_tag = MPEG4_TAG_VOP;
-				ctx->main_count++;
-			} else
-				ctx->state = MPEG4_PARSER_NO_CODE;
+		case PARSER_CODE_0x3:
+			if (*in == 0x1)
+				ctx->state = PARSER_CODE_1x1;
+			else if (*in == 0x0)
+				ctx->tmp_code_start++;
+			else
+				ctx->state = PARSER_NO_CODE;
+			break;
+		case PARSER_CODE_1x1:
+			ctx->state = PARSER_NO_CODE;
+			/* The header of the unit is read ahead from the
+			 * input */
+			tag_flags = codec->unit(ctx, in,
+					in_size + 1 + ctx->lookahead,
+					*consumed, get_head, &tag_type);
 			break;
 		}
 
+		if (tag_flags & PARSER_FRAME_PIC) {
+			ctx->last_tag = PARSER_TAG_PIC;
+			ctx->main_count++;
+		} else if (tag_flags & PARSER_FRAME_HEAD) {
+			ctx->last_tag = PARSER_TAG_HEAD;
+			ctx->headers_count++;
+		}
+
 		if (get_head == 1 && ctx->headers_count >= 1 && ctx->main_count == 1) {
 			ctx->code_end = ctx->tmp_code_start;
 			ctx->got_end = 1;
@@ -141,6 +271,9 @@ int parse_mpeg4_stream(
 			break;
 		}
 
+		if (tag_flags)
+			parse_tag_add(ctx, tag_flags, tag_type);
+
 		in++;
 		(*consumed)++;
 	}
@@ -154,7 +287,9 @@ int parse_mpeg4_stream(
 		frame_length = *consumed;
 
 
-	if (ctx->code_start >= 0) {
+	if (ctx->code_start >= 0 || !out) {
+		/* In the span mode the beginning of the frame is still
+		 * available in the memory preceding in */
 		frame_length -= ctx->code_start;
 		in = in_orig + ctx->code_start;
 	} else {
@@ -171,7 +306,12 @@ int parse_mpeg4_stream(
 			return 0;
 		}
 
-		memcpy(out, in, frame_length);
+		parse_tag_finish(ctx, ctx->got_end, tag_flags, tag_type);
+
+		if (out)
+			memcpy(out, in, frame_length);
+		else
+			ctx->frame_offs = ctx->code_start;
 		*frame_size += frame_length;
 
 		if (ctx->got_end) {
@@ -179,7 +319,7 @@ int parse_mpeg4_stream(
 			ctx->got_start = 1;
 			ctx->got_end = 0;
 			frame_finished = 1;
-			if (ctx->last_tag == MPEG4_TAG_VOP) {
+			if (ctx->last_tag == PARSER_TAG_PIC) {
 				ctx->seek_end = 1;
 				ctx->main_count = 0;
 				ctx->headers_count = 0;
@@ -187,331 +327,829 @@ int parse_mpeg4_stream(
 				ctx->seek_end = 0;
 				ctx->main_count = 0;
 				ctx->headers_count = 1;
+				/* A new MPEG4 header may use the short header
+				 * or not */
 				ctx->short_header = 0;
-				/* If the last frame used the short then
-				 * we shall save this information, otherwise
-				 * it is necessary to clear it */
 			}
-			memcpy(ctx->bytes, in_orig + ctx->code_end, *consumed - ctx->code_end);
+			if (out)
+				memcpy(ctx->bytes, in_orig + ctx->code_end,
+						*consumed - ctx->code_end);
 		} else {
-			ctx->code_start = 0;
+			/* In the span mode the frame goes on in the next
+			 * call, which begins after the consumed data */
+			ctx->code_start = out ? 0 : ctx->code_start - *consumed;
 			frame_finished = 0;
 		}
 	}
 
+	/* The positions kept in the context are relative to the next call */
 	ctx->tmp_code_start -= *consumed;
+	ctx->prefix_start -= *consumed;
 
 	return frame_finished;
 }
 
-int parse_h264_stream(
-	struct mfc_parser_context *ctx,
-	char* in, int in_size, char* out, int out_size,
-	int *consumed, int *frame_size, char get_head)
+/* Coding types of the MPEG4 vop_coding_type */
+static const char mpeg4_coding[4] = {
+	PARSER_CODING_I, PARSER_CODING_P, PARSER_CODING_B, PARSER_CODING_P,
+};
+
+/* Classify the unit after an MPEG4 start code */
+static int mpeg4_unit(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type)
 {
-	char *in_orig;
+	int flags;
 	char tmp;
-	char frame_finished;
-	int frame_length;
 
-	in_orig = in;
+	parse_count_unit(ctx, *in);
+	tmp = *in & 0xF0;
+	if (tmp == 0x00 || tmp == 0x01 || tmp == 0x20 ||
+		*in == 0xb0 || *in == 0xb2 || *in == 0xb3 ||
+		*in == 0xb5)
+		return PARSER_FRAME_HEAD;
+
+	if (*in != 0xb6)
+		return 0;
+
+	flags = PARSER_FRAME_PIC;
+	/* vop_coding_type, 0 is an I-VOP. S-VOPs are predicted like
+	 * P-VOPs. */
+	ctx->pic_coding = PARSER_CODING_UNKNOWN;
+	if (size >= 2) {
+		*type = ((unsigned char)in[1]) >> 6;
+		if (*type == 0)
+			flags |= PARSER_FRAME_KEY;
+		ctx->pic_coding = mpeg4_coding[*type];
+	}
+	return flags;
+}
 
-	*consumed = 0;
+/* Classify the H263 short header, which begins with 00 00 8x */
+static int mpeg4_short_header(struct mfc_parser_context *ctx, char *in,
+					int size, char get_head, int *type)
+{
+	int flags;
 
-	frame_finished = 0;
+	if ((*in & 0xFC) != 0x80)
+		return 0;
 
-	while (in_size-- > 0) {
-		switch (ctx->state) {
-		case H264_PARSER_NO_CODE:
-			if (*in == 0x0) {
-				ctx->state = H264_PARSER_CODE_0x1;
-				ctx->tmp_code_start = *consumed;
-			}
-			break;
-		case H264_PARSER_CODE_0x1:
-			if (*in == 0x0)
-				ctx->state = H264_PARSER_CODE_0x2;
-			else
-				ctx->state = H264_PARSER_NO_CODE;
-			break;
-		case H264_PARSER_CODE_0x2:
-			if (*in == 0x1) {
-				ctx->state = H264_PARSER_CODE_1x1;
-			} else if (*in == 0x0) {
-				ctx->state = H264_PARSER_CODE_0x3;
-			} else {
-				ctx->state = H264_PARSER_NO_CODE;
-			}
-			break;
-		case H264_PARSER_CODE_0x3:
-			if (*in == 0x1)
-				ctx->state = H264_PARSER_CODE_1x1;
-			else if (*in == 0x0)
-				ctx->tmp_code_start++;
-			else
-				ctx->state = H264_PARSER_NO_CODE;
-			break;
-		case H264_PARSER_CODE_1x1:
-			tmp = *in & 0x1F;
-
-			if (tmp == 1 || tmp == 5) {
-				ctx->state = H264_PARSER_CODE_SLICE;
-			} else if (tmp == 6 || tmp == 7 || tmp == 8) {
-				ctx->state = H264_PARSER_NO_CODE;
-				ctx->last_tag = H264_TAG_HEAD;
-				ctx->headers_count++;
-			}
-			else
-				ctx->state = H264_PARSER_NO_CODE;
-			break;
-		case H264_PARSER_CODE_SLICE:
-			if ((*in & 0x80) == 0x80) {
-				ctx->main_count++;
-				ctx->last_tag = H264_TAG_SLICE;
-			}
-			ctx->state = H264_PARSER_NO_CODE;
-			break;
-		}
+	/* Ignore the short header if the current hasn't been started with
+	 * a short header. */
+	if (get_head && !ctx->short_header) {
+		ctx->short_header = 1;
+		return PARSER_FRAME_HEAD;
+	}
 
-		if (get_head == 1 && ctx->headers_count >= 1 && ctx->main_count == 1) {
-			ctx->code_end = ctx->tmp_code_start;
-			ctx->got_end = 1;
-			break;
-		}
+	if (ctx->seek_end && !ctx->short_header)
+		return 0;
+
+	ctx->short_header = 1;
+	flags = PARSER_FRAME_PIC;
+	/* The picture coding type is in PTYPE, unless the extended
+	 * PLUSPTYPE is used */
+	ctx->pic_coding = PARSER_CODING_UNKNOWN;
+	if (size >= 3 && (((unsigned char)in[2] >> 2) & 7) != 7) {
+		*type = (in[2] >> 1) & 1;
+		if (*type == 0)
+			flags |= PARSER_FRAME_KEY;
+		ctx->pic_coding = *type ? PARSER_CODING_P : PARSER_CODING_I;
+	}
+	return flags;
+}
 
-		if (ctx->got_start == 0 && ctx->headers_count == 1 && ctx->main_count == 0) {
-			ctx->code_start = ctx->tmp_code_start;
-			ctx->got_start = 1;
+static const struct parse_codec mpeg4_codec = {
+	.zero_byte = 0,
+	.unit = mpeg4_unit,
+	.short_header = mpeg4_short_header,
+};
+
+int parse_mpeg4_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	return parse_codes(ctx, in, in_size, out, out_size, consumed,
+				frame_size, get_head, &mpeg4_codec);
+}
+
+/* Classes of H264 NAL units (h264_classify) */
+enum h264_nal_class {
+	/* Belongs to the current access unit */
+	H264_NAL_OTHER,
+	/* Begins a new access unit if it follows a slice (7.4.1.2.3) */
+	H264_NAL_HEAD,
+	/* The first slice of a new primary coded picture */
+	H264_NAL_PIC,
+	/* Another slice of the current picture */
+	H264_NAL_SLICE,
+	/* Prefix NAL unit, it belongs to the following slice */
+	H264_NAL_PREFIX,
+};
+
+static void h264_parse_sps(struct mfc_parser_context *ctx, struct bits *b)
+{
+	struct h264_sps sps;
+	unsigned int profile_idc, id, chroma_format_idc;
+	unsigned int n, cnt;
+
+	memzero(sps);
+	profile_idc = bits_read(b, 8);
+	/* constraint_set flags and level_idc */
+	bits_read(b, 16);
+	id = bits_read_ue(b);
+	if (id >= H264_MAX_SPS)
+		return;
+
+	if (h264_profile_has_chroma_format(profile_idc)) {
+		chroma_format_idc = bits_read_ue(b);
+		if (chroma_format_idc == 3)
+			sps.separate_colour_plane = bits_read(b, 1);
+		/* bit_depth_luma_minus8, bit_depth_chroma_minus8 and
+		 * qpprime_y_zero_transform_bypass_flag */
+		bits_read_ue(b);
+		bits_read_ue(b);
+		bits_read(b, 1);
+		if (bits_read(b, 1)) {
+			cnt = chroma_format_idc == 3 ? 12 : 8;
+			for (n = 0; n < cnt; n++)
+				if (bits_read(b, 1))
+					h264_skip_scaling_list(b, n < 6 ? 16 : 64);
 		}
+	}
 
-		if (ctx->got_start == 0 && ctx->headers_count == 0 && ctx->main_count == 1) {
-			ctx->code_start = ctx->tmp_code_start;
-			ctx->got_start = 1;
-			ctx->seek_end = 1;
-			ctx->headers_count = 0;
-			ctx->main_count = 0;
+	sps.log2_max_frame_num = bits_read_ue(b) + 4;
+	sps.poc_type = bits_read_ue(b);
+	if (sps.poc_type == 0) {
+		sps.log2_max_poc_lsb = bits_read_ue(b) + 4;
+	} else if (sps.poc_type == 1) {
+		sps.delta_pic_order_always_zero = bits_read(b, 1);
+		/* offset_for_non_ref_pic, offset_for_top_to_bottom_field and
+		 * the offsets of the reference frames in the cycle */
+		bits_read_se(b);
+		bits_read_se(b);
+		cnt = bits_read_ue(b);
+		if (cnt > 255) {
+			dbg("Invalid H264 sequence parameter set");
+			return;
 		}
+		for (n = 0; n < cnt; n++)
+			bits_read_se(b);
+	}
+	/* max_num_ref_frames, gaps_in_frame_num_value_allowed_flag */
+	bits_read_ue(b);
+	bits_read(b, 1);
+	sps.width_mbs = bits_read_ue(b) + 1;
+	sps.height_map_units = bits_read_ue(b) + 1;
+	sps.frame_mbs_only = bits_read(b, 1);
+
+	if (b->error || sps.log2_max_frame_num > 16 ||
+			sps.poc_type > 2 || sps.log2_max_poc_lsb > 16) {
+		dbg("Invalid H264 sequence parameter set");
+		return;
+	}
 
-		if (ctx->seek_end == 0 && ctx->headers_count > 0 && ctx->main_count == 1) {
-			ctx->seek_end = 1;
-			ctx->headers_count = 0;
-			ctx->main_count = 0;
+	sps.valid = 1;
+	ctx->sps[id] = sps;
+}
+
+static void h264_parse_pps(struct mfc_parser_context *ctx, struct bits *b)
+{
+	struct h264_pps pps;
+	unsigned int id, sps_id;
+
+	memzero(pps);
+	id = bits_read_ue(b);
+	sps_id = bits_read_ue(b);
+	/* entropy_coding_mode_flag */
+	bits_read(b, 1);
+	pps.bottom_field_pic_order_present = bits_read(b, 1);
+
+	if (b->error || id >= H264_MAX_PPS || sps_id >= H264_MAX_SPS) {
+		dbg("Invalid H264 picture parameter set");
+		return;
+	}
+
+	pps.sps_id = sps_id;
+	pps.valid = 1;
+	ctx->pps[id] = pps;
+}
+
+/* Parse the beginning of the slice header. Returns 0 if the fields needed
+ * to detect the first slice of a picture have been read. */
+static int h264_parse_slice(struct mfc_parser_context *ctx, struct bits *b,
+			int nal_ref_idc, int idr, struct h264_slice *slice)
+{
+	struct h264_pps *pps;
+	struct h264_sps *sps;
+	unsigned int pps_id;
+
+	memzero(*slice);
+	/* first_mb_in_slice */
+	bits_read_ue(b);
+	slice->slice_type = bits_read_ue(b) % 5;
+	pps_id = bits_read_ue(b);
+	if (b->error || pps_id >= H264_MAX_PPS || !ctx->pps[pps_id].valid)
+		return -1;
+	pps = &ctx->pps[pps_id];
+	sps = &ctx->sps[(int)pps->sps_id];
+	if (!sps->valid)
+		return -1;
+
+	slice->nal_ref_idc = nal_ref_idc;
+	slice->idr = idr;
+	slice->pps_id = pps_id;
+	/* colour_plane_id */
+	if (sps->separate_colour_plane)
+		bits_read(b, 2);
+	slice->frame_num = bits_read(b, sps->log2_max_frame_num);
+	if (!sps->frame_mbs_only) {
+		slice->field_pic = bits_read(b, 1);
+		if (slice->field_pic)
+			slice->bottom_field = bits_read(b, 1);
+	}
+	if (idr)
+		slice->idr_pic_id = bits_read_ue(b);
+	if (sps->poc_type == 0) {
+		slice->poc_lsb = bits_read(b, sps->log2_max_poc_lsb);
+		if (pps->bottom_field_pic_order_present && !slice->field_pic)
+			slice->delta_poc_bottom = bits_read_se(b);
+	} else if (sps->poc_type == 1 && !sps->delta_pic_order_always_zero) {
+		slice->delta_poc[0] = bits_read_se(b);
+		if (pps->bottom_field_pic_order_present && !slice->field_pic)
+			slice->delta_poc[1] = bits_read_se(b);
+	}
+
+	if (b->error)
+		return -1;
+
+	slice->valid = 1;
+	return 0;
+}
+
+/* Check whether the slice begins a new primary coded picture, as described
+ * in 7.4.1.2.4 of the H264 specification */
+static int h264_new_picture(struct h264_slice *prev, struct h264_slice *cur)
+{
+	return	prev->frame_num != cur->frame_num ||
+		prev->pps_id != cur->pps_id ||
+		prev->field_pic != cur->field_pic ||
+		prev->bottom_field != cur->bottom_field ||
+		(prev->nal_ref_idc != cur->nal_ref_idc &&
+			(prev->nal_ref_idc == 0 || cur->nal_ref_idc == 0)) ||
+		prev->poc_lsb != cur->poc_lsb ||
+		prev->delta_poc_bottom != cur->delta_poc_bottom ||
+		prev->delta_poc[0] != cur->delta_poc[0] ||
+		prev->delta_poc[1] != cur->delta_poc[1] ||
+		prev->idr != cur->idr ||
+		(prev->idr && prev->idr_pic_id != cur->idr_pic_id);
+}
+
+/* Classify the NAL unit that begins at nal. The size bytes available there
+ * may end before the NAL unit does, the slice header is then checked only
+ * as far as it is available. */
+static int h264_classify(struct mfc_parser_context *ctx, char *nal, int size)
+{
+	struct h264_slice slice;
+	struct bits b;
+	int type = nal[0] & 0x1F;
+	int nal_ref_idc = (nal[0] >> 5) & 0x3;
+	int new_pic;
+
+	ctx->nal_type = type;
+	bits_init(&b, nal + 1, size - 1, 1);
+
+	switch (type) {
+	case 1:
+	case 2:
+	case 5:
+		/* Slices and slice data partitions A */
+		if (h264_parse_slice(ctx, &b, nal_ref_idc, type == 5, &slice)) {
+			/* Without the parameter sets or the complete header
+			 * the first slice of the picture is recognised by
+			 * first_mb_in_slice equal to 0 */
+			new_pic = size < 2 || (nal[1] & 0x80);
+		} else {
+			new_pic = !ctx->slice.valid ||
+				h264_new_picture(&ctx->slice, &slice);
 		}
+		ctx->slice = slice;
+		return new_pic ? H264_NAL_PIC : H264_NAL_SLICE;
+	case 7:
+		h264_parse_sps(ctx, &b);
+		return H264_NAL_HEAD;
+	case 8:
+		h264_parse_pps(ctx, &b);
+		return H264_NAL_HEAD;
+	case 6:
+	case 9:
+	case 15:
+	case 16:
+	case 17:
+	case 18:
+		/* SEI, access unit delimiter, subset SPS, depth parameter set
+		 * and reserved types */
+		return H264_NAL_HEAD;
+	case 14:
+		return H264_NAL_PREFIX;
+	}
 
-		if (ctx->seek_end == 1 && (ctx->headers_count > 0 || ctx->main_count > 0)) {
-			ctx->code_end = ctx->tmp_code_start;
-			ctx->got_end = 1;
-			if (ctx->headers_count == 0)
-				ctx->seek_end = 1;
-			else
-				ctx->seek_end = 0;
-			break;
+	/* End of sequence and stream, filler data, slice data partitions
+	 * B and C, auxiliary and extension slices */
+	return H264_NAL_OTHER;
+}
+
+/* Coding type of the recent slice. SP and SI slices are coded like P and I
+ * slices. */
+static int h264_coding(struct mfc_parser_context *ctx)
+{
+	static const char coding[5] = {
+		PARSER_CODING_P, PARSER_CODING_B, PARSER_CODING_I,
+		PARSER_CODING_P, PARSER_CODING_I,
+	};
+
+	if (ctx->nal_type == 5)
+		return PARSER_CODING_I;
+	if (!ctx->slice.valid)
+		return PARSER_CODING_UNKNOWN;
+	return coding[(int)ctx->slice.slice_type];
+}
+
+/* Classify the H264 NAL unit after a start code */
+static int h264_unit(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type)
+{
+	int nal_class;
+	int flags;
+
+	/* The NAL unit header and the slice header are read ahead from the
+	 * input */
+	nal_class = h264_classify(ctx, in, size);
+	parse_count_unit(ctx, ctx->nal_type);
+	/* The first slice after the headers always begins the picture */
+	if (nal_class == H264_NAL_SLICE && ctx->seek_end == 0)
+		nal_class = H264_NAL_PIC;
+	/* The access unit begins with the prefix. It has to fit in bytes[]
+	 * together with the start code. */
+	if (nal_class == H264_NAL_PIC && ctx->seek_end == 1 &&
+		ctx->prefix_pending && consumed -
+		ctx->prefix_start <= (int)sizeof(ctx->bytes))
+		ctx->tmp_code_start = ctx->prefix_start;
+	if (nal_class != H264_NAL_OTHER)
+		ctx->prefix_pending = 0;
+
+	switch (nal_class) {
+	case H264_NAL_PIC:
+		flags = PARSER_FRAME_PIC;
+		*type = ctx->nal_type;
+		if (ctx->nal_type == 5)
+			flags |= PARSER_FRAME_KEY;
+		ctx->pic_coding = h264_coding(ctx);
+		return flags;
+	case H264_NAL_HEAD:
+		return PARSER_FRAME_HEAD;
+	case H264_NAL_PREFIX:
+		ctx->prefix_pending = 1;
+		ctx->prefix_start = ctx->tmp_code_start;
+		break;
+	}
+	return 0;
+}
+
+static const struct parse_codec h264_codec = {
+	.zero_byte = 1,
+	.unit = h264_unit,
+};
+
+int parse_h264_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	return parse_codes(ctx, in, in_size, out, out_size, consumed,
+				frame_size, get_head, &h264_codec);
+}
+
+/* Classes of HEVC NAL units (hevc_classify) */
+enum hevc_nal_class {
+	/* Belongs to the current access unit */
+	HEVC_NAL_OTHER,
+	/* Begins a new access unit if it follows a slice (7.4.2.4.4) */
+	HEVC_NAL_HEAD,
+	/* The first slice segment of a picture */
+	HEVC_NAL_PIC,
+};
+
+/* Remember the number of extra slice header bits of a picture parameter
+ * set, they precede slice_type */
+static void hevc_parse_pps(struct mfc_parser_context *ctx, struct bits *b)
+{
+	unsigned int pps_id;
+
+	pps_id = bits_read_ue(b);
+	/* pps_seq_parameter_set_id, dependent_slice_segments_enabled_flag,
+	 * output_flag_present_flag */
+	bits_read_ue(b);
+	bits_read(b, 2);
+	if (!b->error && pps_id < HEVC_MAX_PPS)
+		ctx->hevc_pps[pps_id] = bits_read(b, 3) + 1;
+}
+
+/* Read the coding type of the first slice segment of a picture */
+static int hevc_slice_coding(struct mfc_parser_context *ctx, struct bits *b,
+								int type)
+{
+	static const char coding[3] = {
+		PARSER_CODING_B, PARSER_CODING_P, PARSER_CODING_I,
+	};
+	unsigned int pps_id, slice_type;
+
+	/* IRAP pictures contain only I slices */
+	if (type >= 16 && type <= 23)
+		return PARSER_CODING_I;
+
+	/* first_slice_segment_in_pic_flag */
+	bits_read(b, 1);
+	pps_id = bits_read_ue(b);
+	if (b->error || pps_id >= HEVC_MAX_PPS || !ctx->hevc_pps[pps_id])
+		return PARSER_CODING_UNKNOWN;
+	bits_read(b, ctx->hevc_pps[pps_id] - 1);
+	slice_type = bits_read_ue(b);
+	if (b->error || slice_type > 2)
+		return PARSER_CODING_UNKNOWN;
+	return coding[slice_type];
+}
+
+/* Classify the HEVC NAL unit that begins at nal, size bytes are available
+ * there */
+static int hevc_classify(struct mfc_parser_context *ctx, char *nal, int size)
+{
+	int type = (nal[0] >> 1) & 0x3F;
+	struct bits b;
+	int layer_id;
+
+	if (size < 2)
+		return HEVC_NAL_OTHER;
+
+	/* Only the base layer is decoded, NAL units of the other layers
+	 * stay in the access unit */
+	layer_id = ((nal[0] & 0x1) << 5) | ((nal[1] >> 3) & 0x1F);
+	if (layer_id != 0)
+		return HEVC_NAL_OTHER;
+
+	ctx->nal_type = type;
+
+	if (type <= 31) {
+		/* A VCL NAL unit, first_slice_segment_in_pic_flag is the
+		 * first bit of the slice segment header */
+		if (size < 3 || (nal[2] & 0x80)) {
+			bits_init(&b, nal + 2, size - 2, 1);
+			ctx->pic_coding = hevc_slice_coding(ctx, &b, type);
+			return HEVC_NAL_PIC;
 		}
+		return HEVC_NAL_OTHER;
+	}
 
-		in++;
-		(*consumed)++;
+	if (type == 34) {
+		bits_init(&b, nal + 2, size - 2, 1);
+		hevc_parse_pps(ctx, &b);
 	}
 
+	switch (type) {
+	case 32:
+	case 33:
+	case 34:
+	case 35:
+	case 39:
+	case 41 ... 44:
+	case 48 ... 55:
+		/* VPS, SPS, PPS, access unit delimiter, prefix SEI and
+		 * reserved types */
+		return HEVC_NAL_HEAD;
+	}
 
-	*frame_size = 0;
+	/* End of sequence and bitstream, filler data, suffix SEI and
+	 * reserved types */
+	return HEVC_NAL_OTHER;
+}
 
-	if (ctx->got_end == 1) {
-		frame_length = ctx->code_end;
-	} else
-		frame_length = *consumed;
+/* Classify the HEVC NAL unit after a start code */
+static int hevc_unit(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type)
+{
+	int flags;
+
+	/* The NAL unit header and the beginning of the slice segment
+	 * header are read ahead from the input */
+	parse_count_unit(ctx, (*in >> 1) & 0x3F);
+
+	switch (hevc_classify(ctx, in, size)) {
+	case HEVC_NAL_PIC:
+		flags = PARSER_FRAME_PIC;
+		*type = ctx->nal_type;
+		if (ctx->nal_type >= 16 && ctx->nal_type <= 23)
+			flags |= PARSER_FRAME_KEY;
+		return flags;
+	case HEVC_NAL_HEAD:
+		return PARSER_FRAME_HEAD;
+	}
+	return 0;
+}
 
+static const struct parse_codec hevc_codec = {
+	.zero_byte = 1,
+	.unit = hevc_unit,
+};
 
-	if (ctx->code_start >= 0) {
-		frame_length -= ctx->code_start;
-		in = in_orig + ctx->code_start;
-	} else {
-		memcpy(out, ctx->bytes, -ctx->code_start);
-		*frame_size += -ctx->code_start;
-		out += -ctx->code_start;
-		in_size -= -ctx->code_start;
-		in = in_orig;
+int parse_hevc_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	return parse_codes(ctx, in, in_size, out, out_size, consumed,
+				frame_size, get_head, &hevc_codec);
+}
+
+/* Read picture_structure and top_field_first from the MPEG2 picture coding
+ * extension that starts at p. After the first field of a pair the next
+ * picture is expected to be the second field. */
+static void mpeg2_picture_ext(struct mfc_parser_context *ctx,
+							const char *p)
+{
+	int structure = p[3] & 3;
+
+	if (ctx->second_field == 2) {
+		ctx->second_field = 0;
+		return;
 	}
 
-	if (ctx->got_start) {
-		if (out_size < frame_length) {
-			err("Output buffer too small for current frame");
-			return 0;
-		}
-		memcpy(out, in, frame_length);
-		*frame_size += frame_length;
+	ctx->cur_structure = structure;
+	if (structure == 3) {
+		ctx->cur_tff = (p[4] >> 7) & 1;
+	} else if (structure != 0) {
+		ctx->cur_tff = structure == 1;
+		ctx->second_field = 1;
+	}
+}
 
-		if (ctx->got_end) {
-			ctx->code_start = ctx->code_end - *consumed;
-			ctx->got_start = 1;
-			ctx->got_end = 0;
-			frame_finished = 1;
-			if (ctx->last_tag == H264_TAG_SLICE) {
-				ctx->seek_end = 1;
-				ctx->main_count = 0;
-				ctx->headers_count = 0;
-			} else {
-				ctx->seek_end = 0;
-				ctx->main_count = 0;
-				ctx->headers_count = 1;
-			}
-			memcpy(ctx->bytes, in_orig + ctx->code_end, *consumed - ctx->code_end);
-		} else {
-			ctx->code_start = 0;
-			frame_finished = 0;
+/* Coding types of the MPEG1/2 picture_coding_type. D pictures contain only
+ * the DC coefficients of intra blocks. */
+static const char mpeg2_coding[8] = {
+	PARSER_CODING_UNKNOWN, PARSER_CODING_I, PARSER_CODING_P,
+	PARSER_CODING_B, PARSER_CODING_I, PARSER_CODING_UNKNOWN,
+	PARSER_CODING_UNKNOWN, PARSER_CODING_UNKNOWN,
+};
+
+/* Classify the unit after an MPEG1/2 start code */
+static int mpeg2_unit(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type)
+{
+	int flags;
+
+	parse_count_unit(ctx, *in);
+	if (*in == 0xb3 || *in == 0xb8) {
+		dbg("Found header at %d (%x)", consumed, consumed);
+		return PARSER_FRAME_HEAD;
+	}
+
+	if (*in == 0x00 && ctx->second_field == 1) {
+		/* The second field goes to the same frame as the first
+		 * one */
+		ctx->second_field = 2;
+		return 0;
+	}
+
+	if (*in == 0x00) {
+		ctx->second_field = 0;
+		flags = PARSER_FRAME_PIC;
+		/* picture_coding_type follows the 10 bits of
+		 * temporal_reference, 1 is an I picture */
+		ctx->pic_coding = PARSER_CODING_UNKNOWN;
+		if (size >= 3) {
+			*type = (in[2] >> 3) & 7;
+			if (*type == 1)
+				flags |= PARSER_FRAME_KEY;
+			ctx->pic_coding = mpeg2_coding[*type];
 		}
+		dbg("Found picture at %d (%x)", consumed, consumed);
+		return flags;
 	}
 
-	ctx->tmp_code_start -= *consumed;
+	/* picture_coding_extension */
+	if (*in == 0xb5 && size >= 5 && ((in[1] >> 4) & 0xf) == 8)
+		mpeg2_picture_ext(ctx, in);
 
-	return frame_finished;
+	return 0;
 }
 
+static const struct parse_codec mpeg2_codec = {
+	.zero_byte = 0,
+	.unit = mpeg2_unit,
+};
+
 int parse_mpeg2_stream(
 	struct mfc_parser_context *ctx,
 	char* in, int in_size, char* out, int out_size,
 	int *consumed, int *frame_size, char get_head)
 {
-	char *in_orig;
-	char frame_finished;
-	int frame_length;
+	return parse_codes(ctx, in, in_size, out, out_size, consumed,
+				frame_size, get_head, &mpeg2_codec);
+}
 
-	in_orig = in;
+/* Classify the unit after a VC1 start code */
+static int vc1_unit(struct mfc_parser_context *ctx, char *in, int size,
+				int consumed, char get_head, int *type)
+{
+	int flags;
+
+	parse_count_unit(ctx, *in);
+	if (*in == 0x0f || *in == 0x0e) {
+		/* Sequence header or entry point. The frame after an entry
+		 * point can be decoded on its own. */
+		if (*in == 0x0e)
+			ctx->entry_point = 1;
+		dbg("Found header at %d (%x)", consumed, consumed);
+		return PARSER_FRAME_HEAD;
+	}
 
-	*consumed = 0;
+	/* Fields, slices and user data belong to the recent frame or
+	 * header */
+	if (*in != 0x0d)
+		return 0;
+
+	flags = PARSER_FRAME_PIC;
+	/* The picture type is not read, only the key frames are known */
+	ctx->pic_coding = PARSER_CODING_UNKNOWN;
+	if (ctx->entry_point) {
+		flags |= PARSER_FRAME_KEY;
+		ctx->pic_coding = PARSER_CODING_I;
+	}
+	ctx->entry_point = 0;
+	dbg("Found frame at %d (%x)", consumed, consumed);
+	return flags;
+}
 
-	frame_finished = 0;
+static const struct parse_codec vc1_codec = {
+	.zero_byte = 0,
+	.unit = vc1_unit,
+};
 
-	while (in_size-- > 0) {
-		switch (ctx->state) {
-		case MPEG4_PARSER_NO_CODE:
-			if (*in == 0x0) {
-				ctx->state = MPEG4_PARSER_CODE_0x1;
-				ctx->tmp_code_start = *consumed;
-			}
-			break;
-		case MPEG4_PARSER_CODE_0x1:
-			if (*in == 0x0)
-				ctx->state = MPEG4_PARSER_CODE_0x2;
-			else
-				ctx->state = MPEG4_PARSER_NO_CODE;
-			break;
-		case MPEG4_PARSER_CODE_0x2:
-			if (*in == 0x1) {
-				ctx->state = MPEG4_PARSER_CODE_1x1;
-			} else if (*in == 0x0) {
-				/* We still have two zeroes */
-				ctx->tmp_code_start++;
-				// TODO XXX check in h264 and mpeg4
-			} else {
-				ctx->state = MPEG4_PARSER_NO_CODE;
-			}
-			break;
-		case MPEG4_PARSER_CODE_1x1:
-			if (*in == 0xb3 || *in == 0xb8) {
-				ctx->state = MPEG4_PARSER_NO_CODE;
-				ctx->last_tag = MPEG4_TAG_HEAD;
-				ctx->headers_count++;
-				dbg("Found header at %d (%x)", *consumed, *consumed);
-			} else if (*in == 0x00) {
-				ctx->state = MPEG4_PARSER_NO_CODE;
-				ctx->last_tag = MPEG4_TAG_VOP;
-				ctx->main_count++;
-				dbg("Found picture at %d (%x)", *consumed, *consumed);
-			} else
-				ctx->state = MPEG4_PARSER_NO_CODE;
-			break;
-		}
+int parse_vc1_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	return parse_codes(ctx, in, in_size, out, out_size, consumed,
+				frame_size, get_head, &vc1_codec);
+}
 
-		if (get_head == 1 && ctx->headers_count >= 1 && ctx->main_count == 1) {
-			ctx->code_end = ctx->tmp_code_start;
-			ctx->got_end = 1;
-			break;
-		}
+/* Size of the RCV sequence layer and of the frame layer header, the
+ * second version of the format adds STRUCT_B and the time stamps */
+#define RCV_V1_HEADER_SIZE	20
+#define RCV_V2_HEADER_SIZE	36
 
-		if (ctx->got_start == 0 && ctx->headers_count == 1 && ctx->main_count == 0) {
-			ctx->code_start = ctx->tmp_code_start;
-			ctx->got_start = 1;
-		}
+int parse_vc1_rcv_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	unsigned char *p = (unsigned char *)in;
+	int readable = in_size + ctx->lookahead;
+	int size;
 
-		if (ctx->got_start == 0 && ctx->headers_count == 0 && ctx->main_count == 1) {
-			ctx->code_start = ctx->tmp_code_start;
-			ctx->got_start = 1;
-			ctx->seek_end = 1;
-			ctx->headers_count = 0;
-			ctx->main_count = 0;
-		}
+	*consumed = 0;
+	*frame_size = 0;
 
-		if (ctx->seek_end == 0 && ctx->headers_count > 0 && ctx->main_count == 1) {
-			ctx->seek_end = 1;
-			ctx->headers_count = 0;
-			ctx->main_count = 0;
+	if (!ctx->rcv_frame_header) {
+		/* NUMFRAMES is followed by 0x85 or 0xC5 and the size of
+		 * STRUCT_C, which is always 4 */
+		if (readable < RCV_V2_HEADER_SIZE)
+			return 0;
+		if ((p[3] & ~0x40) != 0x85 || p[4] != 4 || p[5] || p[6] ||
+									p[7]) {
+			err("The stream does not begin with an RCV header");
+			return 0;
 		}
-
-		if (ctx->seek_end == 1 && (ctx->headers_count > 0 || ctx->main_count > 0)) {
-			ctx->code_end = ctx->tmp_code_start;
-			ctx->got_end = 1;
-			if (ctx->headers_count == 0)
-				ctx->seek_end = 1;
-			else
-				ctx->seek_end = 0;
-			break;
+		if (p[3] & 0x40) {
+			size = RCV_V2_HEADER_SIZE;
+			ctx->rcv_frame_header = 8;
+		} else {
+			size = RCV_V1_HEADER_SIZE;
+			ctx->rcv_frame_header = 4;
+		}
+		ctx->cur_flags = PARSER_FRAME_HEAD;
+	} else {
+		/* FRAMESIZE has 24 bits, the top bit marks a key frame */
+		if (readable < ctx->rcv_frame_header)
+			return 0;
+		size = ctx->rcv_frame_header + (p[0] | p[1] << 8 | p[2] << 16);
+		ctx->cur_flags = PARSER_FRAME_PIC;
+		ctx->cur_coding = PARSER_CODING_UNKNOWN;
+		if (p[3] & 0x80) {
+			ctx->cur_flags |= PARSER_FRAME_KEY;
+			ctx->cur_coding = PARSER_CODING_I;
 		}
+	}
 
-		in++;
-		(*consumed)++;
+	if (size > parse_avail(ctx, in_size, out))
+		return 0;
+	if (size > out_size) {
+		err("Output buffer too small for current frame");
+		return 0;
 	}
 
-	*frame_size = 0;
+	if (out)
+		memcpy(out, in, size);
+	else
+		ctx->frame_offs = 0;
+	ctx->frame_flags = ctx->cur_flags;
+	ctx->frame_type = 0;
+	ctx->frame_coding = ctx->cur_coding;
+	*frame_size = size;
+	*consumed = size;
+
+	return 1;
+}
 
-	if (ctx->got_end == 1) {
-		frame_length = ctx->code_end;
-	} else
-		frame_length = *consumed;
 
+/* Size of the IVF file header and of the frame header */
+#define IVF_HEADER_SIZE		32
+#define IVF_FRAME_HEADER_SIZE	12
 
-	if (ctx->code_start >= 0) {
-		frame_length -= ctx->code_start;
-		in = in_orig + ctx->code_start;
-	} else {
-		memcpy(out, ctx->bytes, -ctx->code_start);
-		*frame_size += -ctx->code_start;
-		out += -ctx->code_start;
-		in_size -= -ctx->code_start;
-		in = in_orig;
-	}
+int parse_vp8_ivf_stream(
+	struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head)
+{
+	unsigned char *p = (unsigned char *)in;
+	int readable = in_size + ctx->lookahead;
+	unsigned int size;
+	int offs = 0;
 
-	if (ctx->got_start) {
-		if (out_size < frame_length) {
-			err("Output buffer too small for current frame");
+	*consumed = 0;
+	*frame_size = 0;
+
+	if (!ctx->ivf_header) {
+		if (readable < IVF_HEADER_SIZE)
+			return 0;
+		if (memcmp(p, "DKIF", 4) || memcmp(p + 8, "VP80", 4)) {
+			err("The stream is not VP8 in an IVF file");
 			return 0;
 		}
+		/* The header may be longer than the one defined */
+		offs = p[6] | p[7] << 8;
+		if (offs < IVF_HEADER_SIZE) {
+			err("Invalid IVF header size %d", offs);
+			return 0;
+		}
+	}
 
-		memcpy(out, in, frame_length);
-		*frame_size += frame_length;
-
-		if (ctx->got_end) {
-			ctx->code_start = ctx->code_end - *consumed;
-			ctx->got_start = 1;
-			ctx->got_end = 0;
-			frame_finished = 1;
-			if (ctx->last_tag == MPEG4_TAG_VOP) {
-				ctx->seek_end = 1;
-				ctx->main_count = 0;
-				ctx->headers_count = 0;
-			} else {
-				ctx->seek_end = 0;
-				ctx->main_count = 0;
-				ctx->headers_count = 1;
+	/* Frames without data are skipped, an empty buffer would end the
+	 * decoding */
+	while (1) {
+		if (readable - offs < IVF_FRAME_HEADER_SIZE) {
+			/* The file header and the empty frames need not be
+			 * read again */
+			if (offs && offs <= readable) {
+				ctx->ivf_header = 1;
+				*consumed = offs;
 			}
-			memcpy(ctx->bytes, in_orig + ctx->code_end, *consumed - ctx->code_end);
-		} else {
-			ctx->code_start = 0;
-			frame_finished = 0;
+			return 0;
 		}
+		size = p[offs] | p[offs + 1] << 8 | p[offs + 2] << 16 |
+						(unsigned int)p[offs + 3] << 24;
+		offs += IVF_FRAME_HEADER_SIZE;
+		if (size)
+			break;
 	}
 
-	ctx->tmp_code_start -= *consumed;
+	/* The frame type is read from the first byte of the frame */
+	if (size > parse_avail(ctx, in_size, out) - offs || offs >= readable)
+		return 0;
+	if (size > out_size) {
+		err("Output buffer too small for current frame");
+		return 0;
+	}
 
-	return frame_finished;
+	/* The frame tag begins with the frame type, 0 for key frames */
+	ctx->cur_flags = PARSER_FRAME_PIC;
+	if (!(p[offs] & 1))
+		ctx->cur_flags |= PARSER_FRAME_KEY;
+	/* There is no stream header, MFC reads the resolution from the
+	 * first key frame */
+	if (get_head)
+		ctx->cur_flags |= PARSER_FRAME_HEAD;
+
+	if (out)
+		memcpy(out, in + offs, size);
+	else
+		ctx->frame_offs = offs;
+	ctx->ivf_header = 1;
+	ctx->frame_flags = ctx->cur_flags;
+	ctx->frame_type = p[offs] & 1;
+	ctx->frame_coding = ctx->frame_type ? PARSER_CODING_P :
+							PARSER_CODING_I;
+	*frame_size = size;
+	*consumed = offs + size;
+
+	return 1;
 }
-
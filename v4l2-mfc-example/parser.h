@@ -23,41 +23,92 @@
 #ifndef INCLUDE_PARSER_H
 #define INCLUDE_PARSER_H
 
-/* H264 parser states */
-enum mfc_h264_parser_state {
-	H264_PARSER_NO_CODE,
-	H264_PARSER_CODE_0x1,
-	H264_PARSER_CODE_0x2,
-	H264_PARSER_CODE_0x3,
-	H264_PARSER_CODE_1x1,
-	H264_PARSER_CODE_SLICE,
+#include <stdint.h>
+
+struct parser_stats;
+
+/* States of the parsers of streams with start codes */
+enum mfc_parser_state {
+	PARSER_NO_CODE,
+	PARSER_CODE_0x1,
+	PARSER_CODE_0x2,
+	PARSER_CODE_0x3,
+	PARSER_CODE_1x1,
+};
+
+/* Recent tag type */
+enum mfc_parser_tag_type {
+	PARSER_TAG_HEAD,
+	PARSER_TAG_PIC,
 };
 
-/* H264 recent tag type */
-enum mfc_h264_tag_type {
-	H264_TAG_HEAD,
-	H264_TAG_SLICE,
+/* Number of H264 parameter sets that can be referenced */
+#define H264_MAX_SPS		32
+#define H264_MAX_PPS		256
+
+/* Number of HEVC picture parameter sets that can be referenced */
+#define HEVC_MAX_PPS		64
+
+/* Fields of the H264 sequence parameter set needed to parse the slice
+ * headers */
+struct h264_sps {
+	char valid;
+	char separate_colour_plane;
+	char frame_mbs_only;
+	char poc_type;
+	char log2_max_frame_num;
+	char log2_max_poc_lsb;
+	char delta_pic_order_always_zero;
+	short width_mbs;
+	short height_map_units;
 };
 
-/* MPEG4 parser states */
-enum mfc_mpeg4_parser_state {
-	MPEG4_PARSER_NO_CODE,
-	MPEG4_PARSER_CODE_0x1,
-	MPEG4_PARSER_CODE_0x2,
-	MPEG4_PARSER_CODE_1x1,
+/* Fields of the H264 picture parameter set needed to parse the slice
+ * headers */
+struct h264_pps {
+	char valid;
+	char sps_id;
+	char bottom_field_pic_order_present;
 };
 
-/* MPEG4 recent tag type */
-enum mfc_mpeg4_tag_type {
-	MPEG4_TAG_HEAD,
-	MPEG4_TAG_VOP,
+/* Fields of the H264 slice header that are compared to detect the first
+ * slice of a new primary coded picture (7.4.1.2.4) */
+struct h264_slice {
+	char valid;
+	char nal_ref_idc;
+	char idr;
+	char field_pic;
+	char bottom_field;
+	unsigned char pps_id;
+	unsigned char slice_type;
+	unsigned int frame_num;
+	unsigned int idr_pic_id;
+	unsigned int poc_lsb;
+	int delta_poc_bottom;
+	int delta_poc[2];
 };
 
+/* Flags describing the extracted frame (frame_flags in the context) */
+/* The frame contains stream headers */
+#define PARSER_FRAME_HEAD	0x1
+/* The frame contains a picture */
+#define PARSER_FRAME_PIC	0x2
+/* The first picture of the frame is intra coded */
+#define PARSER_FRAME_KEY	0x4
+
+/* Coding type of the first picture of the extracted frame (frame_coding in
+ * the context). It is unknown for the VC1 pictures that do not follow an
+ * entry point and when the header could not be read. */
+#define PARSER_CODING_UNKNOWN	0
+#define PARSER_CODING_I		1
+#define PARSER_CODING_P		2
+#define PARSER_CODING_B		3
+
 /* Parser context */
 struct mfc_parser_context {
 	int state;
 	int last_tag;
-	char bytes[6];
+	char bytes[32];
 	int main_count;
 	int headers_count;
 	int tmp_code_start;
@@ -67,16 +118,97 @@ struct mfc_parser_context {
 	char got_end;
 	char seek_end;
 	int short_header;
+	/* Offset of the extracted frame relative to the in pointer, used in
+	 * the span mode. It is negative if the frame began in the data
+	 * passed in one of the previous calls. */
+	int frame_offs;
+	/* Type of the recent H264 or HEVC NAL unit */
+	int nal_type;
+	/* H264 parameter sets and the recent slice header */
+	struct h264_sps sps[H264_MAX_SPS];
+	struct h264_pps pps[H264_MAX_PPS];
+	struct h264_slice slice;
+	/* num_extra_slice_header_bits + 1 of the HEVC picture parameter
+	 * sets, 0 if the set has not been found */
+	char hevc_pps[HEVC_MAX_PPS];
+	/* Set when an H264 prefix NAL unit has been found after the recent
+	 * slice. If the following slice begins a new picture then the access
+	 * unit begins with the prefix, at prefix_start. */
+	int prefix_pending;
+	int prefix_start;
+	/* Set when a VC1 entry point has been found, the next frame is a
+	 * key frame */
+	int entry_point;
+	/* Size of the frame layer header of an RCV file, 0 until the
+	 * sequence layer has been parsed */
+	int rcv_frame_header;
+	/* Set when the IVF file header has been read */
+	int ivf_header;
+	/* MPEG2 field pictures come in pairs and both fields are passed in
+	 * one frame. Set to 1 after the first field of a pair and to 2 in
+	 * the second field. */
+	int second_field;
+	/* Flags and type of the frame that is being extracted */
+	int cur_flags;
+	int cur_type;
+	int cur_structure;
+	int cur_tff;
+	int cur_coding;
+	/* Coding type of the recent picture tag */
+	int pic_coding;
+	/* Flags and type of the extracted frame. The type is codec specific:
+	 * nal_unit_type for H264 and HEVC, vop_coding_type for MPEG4 and
+	 * H263, picture_coding_type for MPEG1/2, 0 for VC1 and the frame type
+	 * of VP8 (0 for key frames). */
+	int frame_flags;
+	int frame_type;
+	int frame_coding;
+	/* picture_structure of the first picture of the extracted MPEG2
+	 * frame: 1 or 2 if it is a pair of fields that begins with the top or
+	 * the bottom field, 3 for a frame picture and 0 for MPEG1. For frame
+	 * pictures top_field_first is taken from the stream, for field pairs
+	 * it is set when the top field comes first. */
+	int picture_structure;
+	int top_field_first;
+	/* Start codes found in advance by the indexer, set with
+	 * parse_stream_set_codes */
+	const char *codes_base;
+	const uint64_t *codes;
+	int codes_count;
+	/* Number of bytes following in + in_size that can be read to
+	 * classify a unit, but are left for the next call. Set when the
+	 * stream is fed to the parser in chunks (feed.c). */
+	int lookahead;
+	/* In the span mode the number of bytes of the stream that follow in,
+	 * if there are more than in_size. The frames of RCV and IVF files
+	 * are found from their sizes, so their data does not have to be in
+	 * memory. */
+	int avail;
+	/* Statistics the found units are counted in, NULL when they are
+	 * not collected */
+	struct parser_stats *stats;
 };
 
 /* Initialize the stream parser */
 int parse_stream_init(struct mfc_parser_context *ctx);
 
+/* Give the parser the positions (relative to base) of all runs of two or
+ * more zero bytes that are followed by 01 or 8x, as found by the indexer.
+ * The parser then jumps between them instead of scanning the stream. The
+ * whole stream has to be passed in one piece from base. */
+void parse_stream_set_codes(struct mfc_parser_context *ctx,
+		const char *base, const uint64_t *codes, int count);
+
 /* Parser the stream:
  * - consumed is used to return the number of bytes consumed from the output
  * - frame_size is used to return the size of the frame that has been extracted
  * - get_head - when equal to 1 it is used to extract the stream header wehn
  *   setting up MFC
+ * If out is NULL the parser works in the span mode. The frame is not copied,
+ * instead its position is returned in ctx->frame_offs and its size in
+ * frame_size. In this mode the caller has to keep the data passed in the
+ * previous calls available, as it is the case with an mmapped file. The
+ * out_size argument still limits the size of the frame.
  * Return value: 1 - if a complete frame has been extracted, 0 otherwise
  */
 int parse_mpeg4_stream(struct mfc_parser_context *ctx,
@@ -87,9 +219,33 @@ int parse_h264_stream(struct mfc_parser_context *ctx,
         char* in, int in_size, char* out, int out_size,
         int *consumed, int *frame_size, char get_head);
 
+int parse_hevc_stream(struct mfc_parser_context *ctx,
+        char* in, int in_size, char* out, int out_size,
+        int *consumed, int *frame_size, char get_head);
+
 int parse_mpeg2_stream(struct mfc_parser_context *ctx,
         char* in, int in_size, char* out, int out_size,
         int *consumed, int *frame_size, char get_head);
 
+/* VC1 advanced profile stream with start codes (SMPTE 421M Annex G) */
+int parse_vc1_stream(struct mfc_parser_context *ctx,
+        char* in, int in_size, char* out, int out_size,
+        int *consumed, int *frame_size, char get_head);
+
+/* VC1 simple and main profile in the RCV format (SMPTE 421M Annex L). The
+ * sequence layer is the header and every frame is passed with its frame
+ * layer header. The whole frame has to be passed in one call. */
+int parse_vc1_rcv_stream(struct mfc_parser_context *ctx,
+        char* in, int in_size, char* out, int out_size,
+        int *consumed, int *frame_size, char get_head);
+
+/* VP8 in an IVF file. The file and frame headers are not passed to MFC,
+ * every frame is returned without its header and frames without data are
+ * skipped. The header extracted with get_head is the first frame, which
+ * has to be passed again. The whole frame has to be passed in one call. */
+int parse_vp8_ivf_stream(struct mfc_parser_context *ctx,
+        char* in, int in_size, char* out, int out_size,
+        int *consumed, int *frame_size, char get_head);
+
 #endif /* PARSER_H_ */
 
@@ -0,0 +1,552 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Stream parser benchmark
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "bitgen.h"
+#include "common.h"
+#include "feed.h"
+#include "index.h"
+#include "parser.h"
+#include "pindex.h"
+#include "scan.h"
+
+/* Size of the buffer the frames are extracted to */
+#define BENCH_OUT_SIZE	(16 * 1024 * 1024)
+
+typedef int (*parser_func)(struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head);
+
+struct bench_parser {
+	char *name;
+	parser_func func;
+	unsigned long codec;
+};
+
+static struct bench_parser parsers[] = {
+	{ "mpeg4", parse_mpeg4_stream, V4L2_PIX_FMT_MPEG4 },
+	{ "h264", parse_h264_stream, V4L2_PIX_FMT_H264 },
+	{ "hevc", parse_hevc_stream, V4L2_PIX_FMT_HEVC },
+	{ "mpeg2", parse_mpeg2_stream, V4L2_PIX_FMT_MPEG2 },
+	{ "vc1", parse_vc1_stream, V4L2_PIX_FMT_VC1_ANNEX_G },
+	{ "rcv", parse_vc1_rcv_stream, V4L2_PIX_FMT_VC1_ANNEX_L },
+	{ "vp8", parse_vp8_ivf_stream, V4L2_PIX_FMT_VP8 },
+	{ NULL, NULL, 0 },
+};
+
+struct bench_result {
+	int frames;
+	unsigned long long bytes;
+	unsigned int hash;
+	double time;
+	/* CPU cycles of all the repeats, 0 if they cannot be counted */
+	unsigned long long cycles;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The cycles are counted by perf. Without it the time stamp counter is
+ * used on x86, which counts at the nominal frequency. */
+static int cycles_open(void)
+{
+	struct perf_event_attr attr;
+
+	memzero(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static unsigned long long cycles_read(int fd)
+{
+	unsigned long long c;
+
+	if (fd >= 0) {
+		if (read(fd, &c, sizeof(c)) != sizeof(c))
+			return 0;
+		return c;
+	}
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* FNV-1a, used to check that both variants extract the same frames */
+static unsigned int hash_bytes(unsigned int h, const char *p, int size)
+{
+	while (size--) {
+		h ^= (unsigned char)*p++;
+		h *= 16777619;
+	}
+	return h;
+}
+
+static unsigned int hash_frame(unsigned int h, char *p, int size)
+{
+	h ^= size;
+	h *= 16777619;
+	return hash_bytes(h, p, size);
+}
+
+/* Hash of a frame found by the chunked parser, equal to hash_frame of its
+ * data in one piece */
+static unsigned int hash_spans(unsigned int h, struct feed_frame *fr)
+{
+	int n;
+
+	h ^= fr->size;
+	h *= 16777619;
+	for (n = 0; n < fr->count; n++)
+		h = hash_bytes(h, fr->span[n].p, fr->span[n].size);
+	return h;
+}
+
+/* Run the parser over the whole stream in the same way as the decoder
+ * does it. If out is NULL the parser is used in the span mode. If verify
+ * is set then a hash of all the frames is computed. */
+static int bench_run(parser_func func, unsigned long codec, char *in,
+		int size, char *out, int verify, struct bench_result *res)
+{
+	struct mfc_parser_context ctx;
+	int used, fs, ret;
+	int offs = 0;
+
+	parse_stream_init(&ctx);
+
+	ret = func(&ctx, in, size, out, BENCH_OUT_SIZE, &used, &fs, 1);
+	if (ret == 0) {
+		err("Failed to extract header from stream");
+		return -1;
+	}
+	res->frames++;
+	res->bytes += fs;
+	if (verify)
+		res->hash = hash_frame(res->hash,
+				out ? out : in + ctx.frame_offs, fs);
+	/* The header of VP8 is the first frame, which is passed again */
+	if (codec == V4L2_PIX_FMT_VP8)
+		parse_stream_init(&ctx);
+	else
+		offs += used;
+
+	while (1) {
+		ret = func(&ctx, in + offs, size - offs, out, BENCH_OUT_SIZE,
+							&used, &fs, 0);
+		if (ret == 0 && offs == size)
+			break;
+		if (ret == 0 && used == 0) {
+			err("Parser made no progress at offset %d", offs);
+			return -1;
+		}
+		res->frames++;
+		res->bytes += fs;
+		if (verify)
+			res->hash = hash_frame(res->hash,
+				out ? out : in + offs + ctx.frame_offs, fs);
+		offs += used;
+	}
+
+	return 0;
+}
+
+static int bench(struct bench_parser *p, char *in, int size, char *out,
+			int repeats, int bytewise, struct bench_result *res)
+{
+	unsigned long long cycles;
+	double start;
+	int fd, n;
+
+	scan_bytewise = bytewise;
+
+	memzero(*res);
+	if (bench_run(p->func, p->codec, in, size, out, 1, res))
+		return -1;
+
+	fd = cycles_open();
+	start = now();
+	cycles = cycles_read(fd);
+	for (n = 0; n < repeats; n++) {
+		struct bench_result tmp;
+
+		memzero(tmp);
+		if (bench_run(p->func, p->codec, in, size, out, 0, &tmp))
+			return -1;
+	}
+	res->cycles = cycles_read(fd) - cycles;
+	res->time = now() - start;
+	if (!cycles)
+		res->cycles = 0;
+	if (fd >= 0)
+		close(fd);
+
+	return 0;
+}
+
+/* Pass the stream to the chunked parser in chunks of random sizes from 1 to
+ * max bytes. The frames are released as soon as they are found. */
+static int feed_run(struct bench_parser *p, char *in, int size, int max,
+					int verify, struct bench_result *res)
+{
+	unsigned int seed = 1;
+	struct feed_frame fr;
+	struct feed f;
+	int get_head = 1;
+	int offs = 0;
+	int ret, n;
+
+	if (feed_init(&f, p->func, p->codec))
+		return -1;
+
+	while (1) {
+		ret = feed_next(&f, &fr, get_head);
+		if (ret < 0)
+			break;
+		if (ret == 1) {
+			get_head = 0;
+			res->frames++;
+			res->bytes += fr.size;
+			if (verify)
+				res->hash = hash_spans(res->hash, &fr);
+			feed_release(&f, fr.offs + fr.size);
+			continue;
+		}
+		if (offs == size) {
+			if (f.eof)
+				break;
+			feed_end(&f);
+			continue;
+		}
+		seed = seed * 1103515245 + 12345;
+		n = 1 + (seed >> 8) % max;
+		if (n > size - offs)
+			n = size - offs;
+		ret = feed_push(&f, in + offs, n);
+		if (ret < 0)
+			break;
+		offs += n;
+	}
+
+	feed_free(&f);
+	return ret;
+}
+
+/* Run the chunked parser. The first run checks the frames, the following
+ * ones are timed. */
+static int bench_feed(struct bench_parser *p, char *in, int size, int max,
+				int repeats, struct bench_result *res)
+{
+	struct bench_result tmp;
+	double start;
+	int n;
+
+	memzero(*res);
+	if (feed_run(p, in, size, max, 1, res))
+		return -1;
+
+	start = now();
+	for (n = 0; n < repeats; n++) {
+		memzero(tmp);
+		if (feed_run(p, in, size, max, 0, &tmp))
+			return -1;
+	}
+	res->time = now() - start;
+
+	return 0;
+}
+
+/* Build the frame index with the parallel indexer. The first run checks
+ * the frames, the following ones are timed. */
+static int bench_index(struct bench_parser *p, char *in, int size,
+		int threads, int repeats, struct bench_result *res)
+{
+	struct frame_index idx;
+	double start;
+	int n;
+
+	memzero(*res);
+	memzero(idx);
+	if (pindex_build(&idx, p->func, p->codec, in, size, threads))
+		return -1;
+	for (n = 0; n < idx.count; n++) {
+		res->frames++;
+		res->bytes += idx.e[n].size;
+		res->hash = hash_frame(res->hash, in + idx.e[n].offs,
+							idx.e[n].size);
+	}
+	index_free(&idx);
+
+	start = now();
+	for (n = 0; n < repeats; n++) {
+		memzero(idx);
+		if (pindex_build(&idx, p->func, p->codec, in, size, threads))
+			return -1;
+		index_free(&idx);
+	}
+	res->time = now() - start;
+
+	return 0;
+}
+
+static void print_result(char *name, int size, int repeats,
+				struct bench_result *res, double ref)
+{
+	double mbs = (double)size * repeats / res->time / 1e6;
+	double fps = (double)res->frames * repeats / res->time;
+
+	printf("%-10s %8d frames %10.0f frames/s %10.2f MB/s", name,
+						res->frames, fps, mbs);
+	if (res->cycles)
+		printf(" %8.2f cycles/B",
+			(double)res->cycles / ((double)size * repeats));
+	if (ref > 0)
+		printf(" (%.2fx)", ref / res->time);
+	printf("\n");
+}
+
+static int compare(struct bench_result *ref, struct bench_result *res)
+{
+	if (ref->frames != res->frames || ref->bytes != res->bytes ||
+						ref->hash != res->hash) {
+		err("Extracted frames differ (hash %08x vs %08x)", ref->hash,
+								res->hash);
+		return -1;
+	}
+	return 0;
+}
+
+static void print_usage(char *name)
+{
+	printf("Usage:\n");
+	printf("\t./%s\n", name);
+	printf("\t-b <bytes> - Also pass the stream to the chunked parser in\n");
+	printf("\t\t     chunks of 1 to the given number of bytes\n");
+	printf("\t-c <codec> - Parser to benchmark: mpeg4, h264, hevc,\n");
+	printf("\t\t     mpeg2, vc1, rcv, vp8\n");
+	printf("\t-i <file> - Elementary stream to parse\n");
+	printf("\t-j <count> - Also build the frame index with 1, 2, 4...\n");
+	printf("\t\t     up to count threads\n");
+	printf("\t-r <count> - Number of repeats (default 10)\n");
+	printf("\tWithout -i a synthetic stream of the codec is parsed:\n");
+	printf("\t-n <count> - Number of pictures (default 1000)\n");
+	printf("\t-s <bytes> - Average picture size (default 20000)\n");
+	printf("\t-l <count> - Slices per picture (default 1)\n");
+	printf("\t-e <count> - 00 00 0x sequences per 1000 bytes (default 2)\n");
+	printf("\t-k <count> - Key picture interval (default 25)\n");
+	printf("\t-f - Code the MPEG2 pictures as field pairs\n");
+	printf("\t-o <file> - Save the synthetic stream\n");
+	printf("\n");
+}
+
+/* Write the synthetic stream, so it can be replayed with -i */
+static int save_stream(char *name, char *p, int size)
+{
+	int fd;
+
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		err("Failed to create file: %s", name);
+		return -1;
+	}
+	if (write(fd, p, size) != size) {
+		err("Failed to write file: %s", name);
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct bitgen_params gen = { 1000, 20000, 1, 2, 25, 0, 1 };
+	struct bench_result ref, res;
+	struct bench_parser *p = NULL;
+	struct stat in_stat;
+	char *name = NULL;
+	char *save = NULL;
+	char *in, *out;
+	char label[32];
+	int repeats = 10;
+	int threads = 0;
+	int chunk = 0;
+	int fd = -1;
+	int c, n, size;
+
+	while ((c = getopt(argc, argv, "b:c:e:fi:j:k:l:n:o:r:s:")) != -1) {
+		switch (c) {
+		case 'b':
+			chunk = atoi(optarg);
+			break;
+		case 'c':
+			for (n = 0; parsers[n].name; n++)
+				if (strcasecmp(parsers[n].name, optarg) == 0)
+					p = &parsers[n];
+			break;
+		case 'e':
+			gen.emulation = atoi(optarg);
+			break;
+		case 'f':
+			gen.fields = 1;
+			break;
+		case 'i':
+			name = optarg;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 'k':
+			gen.gop = atoi(optarg);
+			break;
+		case 'l':
+			gen.slices = atoi(optarg);
+			break;
+		case 'n':
+			gen.frames = atoi(optarg);
+			break;
+		case 'o':
+			save = optarg;
+			break;
+		case 'r':
+			repeats = atoi(optarg);
+			break;
+		case 's':
+			gen.frame_size = atoi(optarg);
+			break;
+		default:
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!p || repeats < 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (name) {
+		fd = open(name, O_RDONLY);
+		if (fd < 0) {
+			err("Failed to open file: %s", name);
+			return 1;
+		}
+		fstat(fd, &in_stat);
+		size = in_stat.st_size;
+		in = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (in == MAP_FAILED) {
+			err("Failed to map input file");
+			return 1;
+		}
+	} else {
+		size = bitgen_stream(p->name, &gen, &in);
+		if (size < 0)
+			return 1;
+		if (save && save_stream(save, in, size))
+			return 1;
+		printf("Synthetic stream: %d pictures of %d bytes, %d slices, "
+			"%d/1000 emulation, key every %d\n", gen.frames,
+			gen.frame_size, gen.slices, gen.emulation, gen.gop);
+	}
+
+	out = malloc(BENCH_OUT_SIZE);
+	if (!out) {
+		err("Failed to allocate the output buffer");
+		return 1;
+	}
+
+	printf("Parser %s, %d bytes, %d repeats\n", p->name, size, repeats);
+
+	if (bench(p, in, size, out, repeats, 1, &ref))
+		return 1;
+	print_result("byte-wise", size, repeats, &ref, 0);
+
+	if (bench(p, in, size, out, repeats, 0, &res))
+		return 1;
+	print_result((char *)scan_impl_name(), size, repeats, &res, ref.time);
+	if (compare(&ref, &res))
+		return 1;
+
+	if (bench(p, in, size, NULL, repeats, 0, &res))
+		return 1;
+	print_result("span", size, repeats, &res, ref.time);
+	if (compare(&ref, &res))
+		return 1;
+
+	for (n = 1; threads > 0; n *= 2) {
+		if (n > threads)
+			n = threads;
+		if (bench_index(p, in, size, n, repeats, &res))
+			return 1;
+		snprintf(label, sizeof(label), "index/%d", n);
+		print_result(label, size, repeats, &res, ref.time);
+		if (compare(&ref, &res))
+			return 1;
+		if (n == threads)
+			break;
+	}
+
+	if (chunk > 0) {
+		if (bench_feed(p, in, size, chunk, repeats, &res))
+			return 1;
+		snprintf(label, sizeof(label), "feed/%d", chunk);
+		print_result(label, size, repeats, &res, ref.time);
+		if (compare(&ref, &res))
+			return 1;
+	}
+
+	printf("Extracted frames are identical (hash %08x)\n", res.hash);
+
+	free(out);
+	if (fd >= 0) {
+		munmap(in, size);
+		close(fd);
+	} else {
+		free(in);
+	}
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Parallel frame indexer
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <limits.h>
+#include <linux/videodev2.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "index.h"
+#include "parser.h"
+#include "pindex.h"
+#include "scan.h"
+
+/* Number of start codes the list of a chunk grows by */
+#define PINDEX_ALLOC_STEP	4096
+
+/* Part of the stream scanned by one thread. It owns the start codes whose
+ * 01 (or 8x) byte lies in [lo, hi). */
+struct pindex_chunk {
+	const unsigned char *p;
+	int size;
+	int lo;
+	int hi;
+	uint64_t *codes;
+	int count;
+	int alloc;
+	int ret;
+	pthread_t thread;
+};
+
+static int pindex_add(struct pindex_chunk *c, uint64_t offs)
+{
+	uint64_t *codes;
+
+	if (c->count == c->alloc) {
+		codes = realloc(c->codes, (c->alloc + PINDEX_ALLOC_STEP) *
+							sizeof(*codes));
+		if (!codes)
+			return -1;
+		c->codes = codes;
+		c->alloc += PINDEX_ALLOC_STEP;
+	}
+	c->codes[c->count++] = offs;
+	return 0;
+}
+
+static void *pindex_thread_func(void *args)
+{
+	struct pindex_chunk *c = args;
+	const unsigned char *p = c->p;
+	int q, e, start;
+
+	c->ret = -1;
+
+	/* A start code that straddles lo begins before it */
+	q = c->lo >= 2 ? c->lo - 2 : 0;
+	while (c->hi - q >= 2) {
+		q += scan_zero_pair((const char *)p + q, c->hi - q);
+		if (q >= c->hi - 1)
+			break;
+
+		/* The run of zeros may end in the next chunk */
+		for (e = q + 2; e < c->size && p[e] == 0; e++)
+			;
+		if (e >= c->hi)
+			break;
+
+		if (p[e] == 0x01 || (p[e] & 0xfc) == 0x80) {
+			/* ... or begin in the previous one */
+			for (start = q; start > 0 && p[start - 1] == 0; start--)
+				;
+			if (pindex_add(c, start))
+				return 0;
+		}
+		q = e + 1;
+	}
+
+	c->ret = 0;
+	return 0;
+}
+
+int pindex_find_codes(const char *p, int size, int threads,
+							uint64_t **codes)
+{
+	struct pindex_chunk chunks[PINDEX_MAX_THREADS];
+	int count = 0;
+	int error = 0;
+	int n, started;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > size / PINDEX_MIN_CHUNK)
+		threads = size / PINDEX_MIN_CHUNK;
+	if (threads > PINDEX_MAX_THREADS)
+		threads = PINDEX_MAX_THREADS;
+	if (threads < 1)
+		threads = 1;
+
+	memset(chunks, 0, sizeof(chunks));
+	for (n = 0; n < threads; n++) {
+		chunks[n].p = (const unsigned char *)p;
+		chunks[n].size = size;
+		chunks[n].lo = (long long)size * n / threads;
+		chunks[n].hi = (long long)size * (n + 1) / threads;
+	}
+
+	/* The first chunk is scanned by the calling thread */
+	for (started = 1; started < threads; started++)
+		if (pthread_create(&chunks[started].thread, NULL,
+				pindex_thread_func, &chunks[started]))
+			break;
+	pindex_thread_func(&chunks[0]);
+	for (n = 1; n < started; n++)
+		pthread_join(chunks[n].thread, 0);
+	/* The chunks of the threads that failed to start are scanned here */
+	for (n = started; n < threads; n++)
+		pindex_thread_func(&chunks[n]);
+
+	for (n = 0; n < threads; n++) {
+		if (chunks[n].ret)
+			error = 1;
+		count += chunks[n].count;
+	}
+
+	/* Merge the lists, they are in the order of the stream */
+	*codes = NULL;
+	if (!error && count) {
+		*codes = malloc(count * sizeof(**codes));
+		if (!*codes)
+			error = 1;
+	}
+	for (count = 0, n = 0; n < threads; n++) {
+		if (!error)
+			memcpy(*codes + count, chunks[n].codes,
+				chunks[n].count * sizeof(**codes));
+		count += chunks[n].count;
+		free(chunks[n].codes);
+	}
+
+	if (error) {
+		err("Failed to allocate the list of start codes");
+		return -1;
+	}
+
+	return count;
+}
+
+int pindex_build(struct frame_index *idx, pindex_parser func,
+		unsigned long codec, char *p, int size, int threads)
+{
+	struct mfc_parser_context ctx;
+	uint64_t *codes = NULL;
+	int count = 0;
+	int used, fs, ret;
+	int offs = 0;
+
+	/* The frames of RCV and IVF files are not delimited by start
+	 * codes */
+	if (codec != V4L2_PIX_FMT_VC1_ANNEX_L && codec != V4L2_PIX_FMT_VP8) {
+		count = pindex_find_codes(p, size, threads, &codes);
+		if (count < 0)
+			return -1;
+	}
+
+	parse_stream_init(&ctx);
+	if (codes)
+		parse_stream_set_codes(&ctx, p, codes, count);
+
+	ret = func(&ctx, p, size, NULL, INT_MAX, &used, &fs, 1);
+	if (ret == 0) {
+		err("Failed to extract header from stream");
+		goto err;
+	}
+	if (index_add(idx, ctx.frame_offs, fs, ctx.frame_flags,
+							ctx.frame_type))
+		goto err;
+
+	if (codec == V4L2_PIX_FMT_H263 || codec == V4L2_PIX_FMT_VP8) {
+		/* The header is passed again with the first frame, the same
+		 * as in the decoder */
+		parse_stream_init(&ctx);
+		if (codes)
+			parse_stream_set_codes(&ctx, p, codes, count);
+	} else {
+		offs += used;
+	}
+
+	while (1) {
+		ret = func(&ctx, p + offs, size - offs, NULL, INT_MAX,
+							&used, &fs, 0);
+		if (ret == 0 && (offs == size || used == 0))
+			break;
+		if (index_add(idx, offs + ctx.frame_offs, fs,
+					ctx.frame_flags, ctx.frame_type))
+			goto err;
+		offs += used;
+	}
+
+	free(codes);
+	return 0;
+err:
+	free(codes);
+	return -1;
+}
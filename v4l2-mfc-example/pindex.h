@@ -0,0 +1,54 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Parallel frame indexer header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_PINDEX_H
+#define INCLUDE_PINDEX_H
+
+#include <stdint.h>
+
+#include "index.h"
+#include "parser.h"
+
+/* Maximum number of threads scanning the stream */
+#define PINDEX_MAX_THREADS	16
+/* Minimum size of the part of the stream scanned by one thread */
+#define PINDEX_MIN_CHUNK	(1024 * 1024)
+
+typedef int (*pindex_parser)(struct mfc_parser_context *ctx,
+	char* in, int in_size, char* out, int out_size,
+	int *consumed, int *frame_size, char get_head);
+
+/* Find the start codes in the stream with the given number of threads,
+ * 0 to use one per core. The stream is split in chunks that are scanned in
+ * parallel. The positions of the start codes (see parse_stream_set_codes)
+ * are returned in *codes, which has to be freed.
+ * Return value: the number of start codes or -1 on error */
+int	pindex_find_codes(const char *p, int size, int threads,
+							uint64_t **codes);
+/* Build the frame index of the stream. The start codes are found in
+ * parallel, then the parser is run over them to find the frames. The
+ * result is the same as when the parser scans the whole stream.
+ * Return value: 0 on success, -1 on error */
+int	pindex_build(struct frame_index *idx, pindex_parser func,
+		unsigned long codec, char *p, int size, int threads);
+
+#endif /* INCLUDE_PINDEX_H */
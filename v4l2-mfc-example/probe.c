@@ -0,0 +1,353 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Stream header probe
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <linux/videodev2.h>
+#include <string.h>
+
+#include "bits.h"
+#include "common.h"
+#include "probe.h"
+
+/* Alignment of the NV12MT buffers allocated by MFC */
+#define NV12MT_HALIGN		128
+#define NV12MT_VALIGN		32
+#define NV12MT_PLANE_ALIGN	8192
+
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((a) - 1))
+
+/* Maximum size of the picture buffer in macroblocks for the H264 levels
+ * (Table A-1 of the standard) */
+static const struct {
+	int level_idc;
+	int max_dpb_mbs;
+} h264_levels[] = {
+	{  9,    396 }, { 10,    396 }, { 11,    900 }, { 12,   2376 },
+	{ 13,   2376 }, { 20,   2376 }, { 21,   4752 }, { 22,   8100 },
+	{ 30,   8100 }, { 31,  18000 }, { 32,  20480 }, { 40,  32768 },
+	{ 41,  32768 }, { 42,  34816 }, { 50, 110400 }, { 51, 184320 },
+	{ 52, 184320 },
+};
+
+static int probe_h264_sps(struct stream_probe *s, struct bits *b)
+{
+	unsigned int profile_idc, level_idc, chroma_format_idc = 1;
+	unsigned int frame_mbs_only, width_mbs, height_mbs;
+	unsigned int crop_x = 1, crop_y, left, right, top, bottom;
+	unsigned int n, cnt;
+	int dpb = 16;
+
+	profile_idc = bits_read(b, 8);
+	/* constraint_set flags */
+	bits_read(b, 8);
+	level_idc = bits_read(b, 8);
+	/* seq_parameter_set_id */
+	bits_read_ue(b);
+
+	if (h264_profile_has_chroma_format(profile_idc)) {
+		chroma_format_idc = bits_read_ue(b);
+		if (chroma_format_idc == 3 && bits_read(b, 1))
+			/* Colour planes are coded separately as monochrome
+			 * pictures */
+			chroma_format_idc = 0;
+		/* bit_depth_luma_minus8, bit_depth_chroma_minus8 and
+		 * qpprime_y_zero_transform_bypass_flag */
+		bits_read_ue(b);
+		bits_read_ue(b);
+		bits_read(b, 1);
+		if (bits_read(b, 1)) {
+			cnt = chroma_format_idc == 3 ? 12 : 8;
+			for (n = 0; n < cnt; n++)
+				if (bits_read(b, 1))
+					h264_skip_scaling_list(b, n < 6 ? 16 : 64);
+		}
+	}
+
+	/* log2_max_frame_num_minus4 */
+	bits_read_ue(b);
+	n = bits_read_ue(b);
+	if (n == 0) {
+		/* log2_max_pic_order_cnt_lsb_minus4 */
+		bits_read_ue(b);
+	} else if (n == 1) {
+		/* delta_pic_order_always_zero_flag, offset_for_non_ref_pic,
+		 * offset_for_top_to_bottom_field and the offsets of the
+		 * reference frames in the cycle */
+		bits_read(b, 1);
+		bits_read_se(b);
+		bits_read_se(b);
+		cnt = bits_read_ue(b);
+		if (cnt > 255)
+			return -1;
+		for (n = 0; n < cnt; n++)
+			bits_read_se(b);
+	}
+	s->ref_frames = bits_read_ue(b);
+	/* gaps_in_frame_num_value_allowed_flag */
+	bits_read(b, 1);
+	width_mbs = bits_read_ue(b) + 1;
+	height_mbs = bits_read_ue(b) + 1;
+	frame_mbs_only = bits_read(b, 1);
+	if (!frame_mbs_only)
+		/* mb_adaptive_frame_field_flag */
+		bits_read(b, 1);
+	/* direct_8x8_inference_flag */
+	bits_read(b, 1);
+	height_mbs *= 2 - frame_mbs_only;
+
+	left = right = top = bottom = 0;
+	if (bits_read(b, 1)) {
+		left = bits_read_ue(b);
+		right = bits_read_ue(b);
+		top = bits_read_ue(b);
+		bottom = bits_read_ue(b);
+	}
+
+	if (b->error || width_mbs > 1024 || height_mbs > 1024 ||
+						s->ref_frames > 16)
+		return -1;
+
+	/* The cropping is given in the units of the chroma samples */
+	crop_y = 2 - frame_mbs_only;
+	if (chroma_format_idc == 1 || chroma_format_idc == 2)
+		crop_x = 2;
+	if (chroma_format_idc == 1)
+		crop_y *= 2;
+
+	s->width = width_mbs * 16;
+	s->height = height_mbs * 16;
+	s->crop_left = left * crop_x;
+	s->crop_top = top * crop_y;
+	s->crop_w = s->width - (left + right) * crop_x;
+	s->crop_h = s->height - (top + bottom) * crop_y;
+	if (s->crop_w <= 0 || s->crop_h <= 0)
+		return -1;
+
+	for (n = 0; n < sizeof(h264_levels) / sizeof(h264_levels[0]); n++)
+		if (h264_levels[n].level_idc == level_idc)
+			dpb = h264_levels[n].max_dpb_mbs /
+						(width_mbs * height_mbs);
+	if (dpb > 16)
+		dpb = 16;
+	s->dpb = dpb > s->ref_frames ? dpb : s->ref_frames;
+
+	return 0;
+}
+
+static int probe_h264(struct stream_probe *s, const unsigned char *p,
+						int size, int length_size)
+{
+	struct bits b;
+	int n, len, k;
+
+	for (n = 0; n < size; n += len) {
+		if (length_size) {
+			if (size - n < length_size)
+				break;
+			for (k = 0, len = 0; k < length_size; k++)
+				len = (len << 8) | p[n++];
+			if (len <= 0 || len > size - n)
+				break;
+		} else {
+			/* Move to the byte after the start code */
+			len = 1;
+			if (size - n < 4 || p[n] || p[n + 1] || p[n + 2] != 1)
+				continue;
+			n += 3;
+		}
+
+		if ((p[n] & 0x1f) != 7)
+			continue;
+		bits_init(&b, (const char *)p + n + 1, size - n - 1, 1);
+		return probe_h264_sps(s, &b);
+	}
+
+	return -1;
+}
+
+static int probe_mpeg4(struct stream_probe *s, const unsigned char *p,
+								int size)
+{
+	unsigned int verid = 1, shape, res, bits;
+	struct bits b;
+	int n;
+
+	for (n = 0; n + 4 < size; n++)
+		if (!p[n] && !p[n + 1] && p[n + 2] == 1 &&
+					(p[n + 3] & 0xf0) == 0x20)
+			break;
+	if (n + 4 >= size)
+		return -1;
+
+	bits_init(&b, (const char *)p + n + 4, size - n - 4, 0);
+	/* random_accessible_vol, video_object_type_indication */
+	bits_read(&b, 9);
+	if (bits_read(&b, 1)) {
+		verid = bits_read(&b, 4);
+		/* video_object_layer_priority */
+		bits_read(&b, 3);
+	}
+	if (bits_read(&b, 4) == 15)
+		/* par_width, par_height */
+		bits_read(&b, 16);
+	if (bits_read(&b, 1)) {
+		/* chroma_format, low_delay */
+		bits_read(&b, 3);
+		if (bits_read(&b, 1)) {
+			/* The bit rate and the VBV buffer size and
+			 * occupancy with their markers */
+			bits_read(&b, 32);
+			bits_read(&b, 32);
+			bits_read(&b, 15);
+		}
+	}
+	shape = bits_read(&b, 2);
+	if (shape == 3 && verid != 1)
+		/* video_object_layer_shape_extension */
+		bits_read(&b, 4);
+	/* marker_bit */
+	bits_read(&b, 1);
+	res = bits_read(&b, 16);
+	/* marker_bit */
+	bits_read(&b, 1);
+	if (bits_read(&b, 1)) {
+		/* fixed_vop_time_increment */
+		for (bits = 1; bits < 16 && (1u << bits) < res; bits++)
+			;
+		bits_read(&b, bits);
+	}
+	if (shape != 0)
+		/* Only rectangular objects have their size in the header */
+		return -1;
+	/* The size is surrounded by marker bits */
+	bits_read(&b, 1);
+	s->crop_w = bits_read(&b, 13);
+	bits_read(&b, 1);
+	s->crop_h = bits_read(&b, 13);
+
+	if (b.error || s->crop_w == 0 || s->crop_h == 0)
+		return -1;
+
+	s->width = ALIGN(s->crop_w, 16);
+	s->height = ALIGN(s->crop_h, 16);
+	s->ref_frames = 2;
+	s->dpb = 2;
+
+	return 0;
+}
+
+static int probe_mpeg2(struct stream_probe *s, const unsigned char *p,
+								int size)
+{
+	int n;
+
+	for (n = 0; n + 7 < size; n++)
+		if (!p[n] && !p[n + 1] && p[n + 2] == 1 && p[n + 3] == 0xb3)
+			break;
+	if (n + 7 >= size)
+		return -1;
+
+	s->crop_w = (p[n + 4] << 4) | (p[n + 5] >> 4);
+	s->crop_h = ((p[n + 5] & 0x0f) << 8) | p[n + 6];
+	if (s->crop_w == 0 || s->crop_h == 0)
+		return -1;
+
+	s->width = ALIGN(s->crop_w, 16);
+	s->height = ALIGN(s->crop_h, 16);
+	s->ref_frames = 2;
+	s->dpb = 2;
+
+	return 0;
+}
+
+static int probe_vp8(struct stream_probe *s, const unsigned char *p,
+								int size)
+{
+	/* The frame tag of a key frame is followed by a start code and the
+	 * size with two bits of scaling */
+	if (size < 10 || (p[0] & 1) || p[3] != 0x9d || p[4] != 0x01 ||
+								p[5] != 0x2a)
+		return -1;
+
+	s->crop_w = (p[6] | p[7] << 8) & 0x3fff;
+	s->crop_h = (p[8] | p[9] << 8) & 0x3fff;
+	if (s->crop_w == 0 || s->crop_h == 0)
+		return -1;
+
+	s->width = ALIGN(s->crop_w, 16);
+	s->height = ALIGN(s->crop_h, 16);
+	/* The last, golden and altref frames */
+	s->ref_frames = 3;
+	s->dpb = 3;
+
+	return 0;
+}
+
+int probe_header(struct stream_probe *s, unsigned long codec,
+			const char *p, int size, int length_size)
+{
+	const unsigned char *u = (const unsigned char *)p;
+	int ret;
+
+	memzero(*s);
+
+	switch (codec) {
+	case V4L2_PIX_FMT_H264:
+		ret = probe_h264(s, u, size, length_size);
+		break;
+	case V4L2_PIX_FMT_MPEG4:
+	case V4L2_PIX_FMT_XVID:
+		ret = probe_mpeg4(s, u, size);
+		break;
+	case V4L2_PIX_FMT_MPEG1:
+	case V4L2_PIX_FMT_MPEG2:
+		ret = probe_mpeg2(s, u, size);
+		break;
+	case V4L2_PIX_FMT_VP8:
+		ret = probe_vp8(s, u, size);
+		break;
+	default:
+		ret = -1;
+		break;
+	}
+
+	if (ret) {
+		memzero(*s);
+		return -1;
+	}
+
+	s->valid = 1;
+	dbg("Probed stream header: %dx%d crop %dx%d+%d+%d refs=%d dpb=%d",
+		s->width, s->height, s->crop_w, s->crop_h, s->crop_left,
+		s->crop_top, s->ref_frames, s->dpb);
+
+	return 0;
+}
+
+void probe_capture_format(struct stream_probe *s, int *w, int *h,
+								int *sizes)
+{
+	*w = ALIGN(s->width, NV12MT_HALIGN);
+	*h = ALIGN(s->height, NV12MT_VALIGN);
+	sizes[0] = ALIGN(*w * *h, NV12MT_PLANE_ALIGN);
+	sizes[1] = ALIGN(*w * ALIGN(s->height >> 1, NV12MT_VALIGN),
+							NV12MT_PLANE_ALIGN);
+}
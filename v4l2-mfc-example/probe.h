@@ -0,0 +1,56 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Stream header probe header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_PROBE_H
+#define INCLUDE_PROBE_H
+
+/* Parameters of the stream read from its header by the CPU. They are
+ * known before MFC has processed the header, so the setup that depends
+ * only on them can be done in the meantime. */
+struct stream_probe {
+	int valid;
+	/* Coded size, a multiple of the macroblock size */
+	int width;
+	int height;
+	/* Visible part of the picture */
+	int crop_left;
+	int crop_top;
+	int crop_w;
+	int crop_h;
+	/* Number of reference frames and the size of the picture buffer */
+	int ref_frames;
+	int dpb;
+};
+
+/* Read the resolution from the sequence parameter set (H264), the video
+ * object layer (MPEG4), the sequence header (MPEG2) or the first key frame
+ * (VP8) in the stream header. With length_size != 0 the NAL units of H264
+ * are preceded by their length as in MP4 files instead of start codes.
+ * Return value: 0 on success, -1 if the header has not been recognised */
+int	probe_header(struct stream_probe *s, unsigned long codec,
+			const char *p, int size, int length_size);
+/* Predict the format of the CAPTURE queue of MFC: the size of the NV12MT
+ * buffers and their planes */
+void	probe_capture_format(struct stream_probe *s, int *w, int *h,
+								int *sizes);
+
+#endif /* INCLUDE_PROBE_H */
@@ -20,70 +20,127 @@
  *
  */
 
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "common.h"
 #include "queue.h"
 
-#include <pthread.h>
-#include <stdlib.h>
-
 int queue_init(struct queue *q, int size)
 {
+	if (size & (size - 1)) {
+		err("Queue size %d is not a power of two", size);
+		return -1;
+	}
+
+	memset(q, 0, sizeof(*q));
 	q->q = (int*)malloc(size * sizeof(int));
 	if (!q->q) {
 		err("Failed to init queue (malloc failed)");
 		return -1;
 	}
 	q->size = size;
-	q->head = 0;
-	q->tail = 0;
-	q->n = 0;
-	pthread_mutex_init(&q->mutex, NULL);
 	return 0;
 }
 
+/* The waiting side announces that it is going to sleep before it checks the
+ * index for the last time, the other side checks for a sleeping thread after
+ * it has moved the index. With the full barriers between the two steps on
+ * both sides at least one of them sees the other, so a wake up is never
+ * lost. */
+int queue_sync_wait(struct queue_sync *s, unsigned int *idx, unsigned int val)
+{
+	int wake;
+
+	wake = __atomic_load_n(&s->wake, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&s->waiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(idx, __ATOMIC_SEQ_CST) == val &&
+			!__atomic_load_n(&s->closed, __ATOMIC_ACQUIRE))
+		/* Returns at once if wake has changed since it was read */
+		syscall(SYS_futex, &s->wake, FUTEX_WAIT_PRIVATE, wake,
+							NULL, NULL, 0);
+
+	__atomic_sub_fetch(&s->waiting, 1, __ATOMIC_RELAXED);
+
+	if (__atomic_load_n(idx, __ATOMIC_ACQUIRE) == val &&
+			__atomic_load_n(&s->closed, __ATOMIC_ACQUIRE))
+		return -1;
+	return 0;
+}
+
+void queue_sync_wake(struct queue_sync *s)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&s->waiting, __ATOMIC_RELAXED))
+		return;
+
+	__atomic_add_fetch(&s->wake, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &s->wake, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL,
+									0);
+}
+
+void queue_sync_close(struct queue_sync *s)
+{
+	__atomic_store_n(&s->closed, 1, __ATOMIC_RELEASE);
+	queue_sync_wake(s);
+}
+
 int queue_add(struct queue *q, int e)
 {
-	pthread_mutex_lock(&q->mutex);
-	if (q->n >= q->size) {
-		pthread_mutex_unlock(&q->mutex);
+	unsigned int head = q->head;
+
+	if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == q->size)
 		return -1;
-	}
-	q->q[q->head] = e;
-	q->head++;
-	q->head %= q->size;
-	q->n++;
-	pthread_mutex_unlock(&q->mutex);
+
+	q->q[head & (q->size - 1)] = e;
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+	queue_sync_wake(&q->sync);
 	return 0;
 }
 
 int queue_remove(struct queue *q)
 {
+	unsigned int tail = q->tail;
 	int x;
-	pthread_mutex_lock(&q->mutex);
-	if (q->n == 0) {
-		pthread_mutex_unlock(&q->mutex);
+
+	if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail)
 		return -1;
-	}
-	x = q->q[q->tail];
-	q->tail++;
-	q->tail %= q->size;
-	q->n--;
-	pthread_mutex_unlock(&q->mutex);
+
+	x = q->q[tail & (q->size - 1)];
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
 	return x;
 }
 
-int queue_empty(struct queue *q)
+int queue_wait(struct queue *q)
 {
 	int x;
-	pthread_mutex_lock(&q->mutex);
-	x = (q->n == 0);
-	pthread_mutex_unlock(&q->mutex);
+
+	while ((x = queue_remove(q)) < 0)
+		if (queue_sync_wait(&q->sync, &q->head, q->tail))
+			return -1;
+
 	return x;
 }
 
+void queue_close(struct queue *q)
+{
+	queue_sync_close(&q->sync);
+}
+
+int queue_empty(struct queue *q)
+{
+	return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) ==
+				__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
 void queue_free(struct queue *q)
 {
 	free(q->q);
-	pthread_mutex_destroy(&q->mutex);
+	q->q = NULL;
 }
-
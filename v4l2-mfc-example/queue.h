@@ -23,23 +23,51 @@
 #ifndef INCLUDE_QUEUE_H
 #define INCLUDE_QUEUE_H
 
-#include <pthread.h>
+/* Sleeping of the sides of a single producer, single consumer ring. A side
+ * that cannot go on sleeps on a futex until the other side moves its index
+ * or the ring is closed. The other side only makes a system call when a
+ * thread is actually sleeping. */
+struct queue_sync {
+	/* Futex word, changed to wake up the sleeping threads */
+	int wake;
+	/* Number of the sleeping threads */
+	int waiting;
+	int closed;
+};
 
+/* Single producer, single consumer ring of buffer numbers. Adding and
+ * removing an element does not take a lock. The consumer can sleep until
+ * an element is added. */
 struct queue {
 	int size;
-	int head;
-	int tail;
-	int n;
 	int *q;
-	pthread_mutex_t mutex;
+	/* Written only by the producer and the consumer respectively, kept
+	 * in separate cache lines */
+	unsigned int head __attribute__((aligned(64)));
+	unsigned int tail __attribute__((aligned(64)));
+	struct queue_sync sync __attribute__((aligned(64)));
 };
 
-/* Initialize queue and allocate memory */
+/* Sleep until the index written by the other side is no longer val. Returns
+ * -1 if the ring has been closed and the index has not moved */
+int queue_sync_wait(struct queue_sync *s, unsigned int *idx, unsigned int val);
+/* Wake up the other side after the index has been moved */
+void queue_sync_wake(struct queue_sync *s);
+/* Wake up the sleeping threads and fail their waits */
+void queue_sync_close(struct queue_sync *s);
+
+
+/* Initialize queue and allocate memory, size has to be a power of two */
 int queue_init(struct queue *q, int size);
-/* Add an element to the queue */
+/* Add an element to the queue, -1 if it is full */
 int queue_add(struct queue *q, int e);
-/* Remove the element form queue */
+/* Remove the element form queue, -1 if it is empty */
 int queue_remove(struct queue *q);
+/* Remove the element from the queue, waiting while it is empty. Returns -1
+ * when the queue has been closed and all its elements removed. */
+int queue_wait(struct queue *q);
+/* Wake up the consumer and fail its waits once the queue is empty */
+void queue_close(struct queue *q);
 /* Free the internal queue memory */
 void queue_free(struct queue *q);
 /* Check if the queue is empty */
@@ -0,0 +1,254 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Benchmark of the queue between the MFC and FIMC threads
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "queue.h"
+
+/* Size of the queues, as in the application */
+#define BENCH_QUEUE_SIZE	MFC_MAX_CAP_BUF
+
+/* The queue as it was before: a mutex protected ring with semaphores
+ * counting the elements, as the MFC and FIMC threads used it */
+struct mutex_queue {
+	int q[BENCH_QUEUE_SIZE];
+	int head;
+	int tail;
+	pthread_mutex_t mutex;
+	sem_t sem;
+};
+
+static void mutex_queue_init(struct mutex_queue *q)
+{
+	q->head = 0;
+	q->tail = 0;
+	pthread_mutex_init(&q->mutex, NULL);
+	sem_init(&q->sem, 0, 0);
+}
+
+static void mutex_queue_add(struct mutex_queue *q, int e)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->q[q->head] = e;
+	q->head = (q->head + 1) % BENCH_QUEUE_SIZE;
+	pthread_mutex_unlock(&q->mutex);
+	sem_post(&q->sem);
+}
+
+static int mutex_queue_wait(struct mutex_queue *q)
+{
+	int x;
+
+	sem_wait(&q->sem);
+	pthread_mutex_lock(&q->mutex);
+	x = q->q[q->tail];
+	q->tail = (q->tail + 1) % BENCH_QUEUE_SIZE;
+	pthread_mutex_unlock(&q->mutex);
+	return x;
+}
+
+static void mutex_queue_free(struct mutex_queue *q)
+{
+	pthread_mutex_destroy(&q->mutex);
+	sem_destroy(&q->sem);
+}
+
+/* Elements are sent on todo and returned on done, like the decoded frames
+ * to FIMC and the free CAPTURE buffers back to MFC */
+struct bench_pair {
+	struct queue todo;
+	struct queue done;
+	struct mutex_queue mtodo;
+	struct mutex_queue mdone;
+	int count;
+	int in_flight;
+	int use_mutex;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return every element received on todo on done */
+static void *echo_thread_func(void *args)
+{
+	struct bench_pair *b = args;
+	int n;
+
+	for (n = 0; n < b->count; n++) {
+		if (b->use_mutex)
+			mutex_queue_add(&b->mdone,
+					mutex_queue_wait(&b->mtodo));
+		else
+			queue_add(&b->done, queue_wait(&b->todo));
+	}
+
+	return 0;
+}
+
+/* Send count elements with up to in_flight of them in the echo thread.
+ * Return value: time of one handoff in ns, -1 on error */
+static double bench_handoff(struct bench_pair *b)
+{
+	pthread_t echo_thread;
+	double start;
+	int n, e;
+
+	if (pthread_create(&echo_thread, NULL, echo_thread_func, b)) {
+		err("Failed to create the echo thread");
+		return -1;
+	}
+
+	start = now();
+	for (n = 0; n < b->count; n++) {
+		if (n >= b->in_flight) {
+			if (b->use_mutex)
+				e = mutex_queue_wait(&b->mdone);
+			else
+				e = queue_wait(&b->done);
+			if (e != n - b->in_flight) {
+				err("Received %d instead of %d", e,
+							n - b->in_flight);
+				return -1;
+			}
+		}
+		if (b->use_mutex)
+			mutex_queue_add(&b->mtodo, n);
+		else
+			queue_add(&b->todo, n);
+	}
+	for (n = 0; n < b->in_flight && n < b->count; n++) {
+		if (b->use_mutex)
+			mutex_queue_wait(&b->mdone);
+		else
+			queue_wait(&b->done);
+	}
+	pthread_join(echo_thread, 0);
+
+	/* Every element is passed twice */
+	return (now() - start) * 1e9 / b->count / 2;
+}
+
+/* Add and remove count elements in one thread, so only the cost of the
+ * queue itself is measured. Return value: time of one pair in ns. */
+static double bench_single(struct bench_pair *b)
+{
+	double start;
+	int n;
+
+	start = now();
+	for (n = 0; n < b->count; n++) {
+		if (b->use_mutex) {
+			mutex_queue_add(&b->mtodo, n);
+			mutex_queue_wait(&b->mtodo);
+		} else {
+			queue_add(&b->todo, n);
+			queue_remove(&b->todo);
+		}
+	}
+
+	return (now() - start) * 1e9 / b->count;
+}
+
+static void print_usage(char *name)
+{
+	printf("Usage:\n");
+	printf("\t./%s\n", name);
+	printf("\t-n <count> - Number of elements passed (default 1000000)\n");
+	printf("\t-w <count> - Elements in flight between the threads\n");
+	printf("\t\t     (default 4, at most %d)\n", BENCH_QUEUE_SIZE);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_pair b;
+	double lockfree, mutex;
+	int c;
+
+	memzero(b);
+	b.count = 1000000;
+	b.in_flight = 4;
+
+	while ((c = getopt(argc, argv, "n:w:")) != -1) {
+		switch (c) {
+		case 'n':
+			b.count = atoi(optarg);
+			break;
+		case 'w':
+			b.in_flight = atoi(optarg);
+			break;
+		default:
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (b.count < 1 || b.in_flight < 1 ||
+				b.in_flight > BENCH_QUEUE_SIZE) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (queue_init(&b.todo, BENCH_QUEUE_SIZE) ||
+				queue_init(&b.done, BENCH_QUEUE_SIZE))
+		return 1;
+	mutex_queue_init(&b.mtodo);
+	mutex_queue_init(&b.mdone);
+
+	printf("%d elements, %d in flight, %ld CPUs\n", b.count, b.in_flight,
+					sysconf(_SC_NPROCESSORS_ONLN));
+
+	b.use_mutex = 0;
+	lockfree = bench_single(&b);
+	b.use_mutex = 1;
+	mutex = bench_single(&b);
+	printf("add and remove in one thread:  lock-free %7.1f ns, "
+			"mutex and semaphore %7.1f ns\n", lockfree, mutex);
+
+	b.use_mutex = 0;
+	lockfree = bench_handoff(&b);
+	b.use_mutex = 1;
+	mutex = bench_handoff(&b);
+	if (lockfree < 0 || mutex < 0)
+		return 1;
+	printf("handoff between two threads:   lock-free %7.1f ns, "
+			"mutex and semaphore %7.1f ns\n", lockfree, mutex);
+
+	queue_free(&b.todo);
+	queue_free(&b.done);
+	mutex_queue_free(&b.mtodo);
+	mutex_queue_free(&b.mdone);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Start code scanner
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "scan.h"
+
+/* The implementation is chosen at compile time. SCAN_GENERIC can be
+ * defined to force the portable version on any architecture. */
+#if defined(SCAN_GENERIC)
+#define SCAN_WORD
+#elif defined(__AVX2__)
+#define SCAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCAN_NEON
+#include <arm_neon.h>
+#else
+#define SCAN_WORD
+#endif
+
+int scan_bytewise;
+
+/* Check the bytes one by one, starting from p. This is used for the tail
+ * of the buffer that is too short for the vector code. */
+static int scan_tail(const unsigned char *in, int p, int len)
+{
+	for (; p < len - 1; p++)
+		if (in[p] == 0 && in[p + 1] == 0)
+			return p;
+	return len - 1;
+}
+
+#if defined(SCAN_AVX2)
+
+const char *scan_impl_name(void)
+{
+	return "avx2";
+}
+
+int scan_zero_pair(const char *buf, int len)
+{
+	const unsigned char *in = (const unsigned char *)buf;
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i a, b;
+	unsigned int m;
+	int p = 0;
+
+	if (len < 2)
+		return 0;
+
+	/* Compare the block and the block shifted by one byte against zero,
+	 * the bits set in both masks mark the zero pairs */
+	while (p + 33 <= len) {
+		a = _mm256_loadu_si256((const __m256i *)(in + p));
+		b = _mm256_loadu_si256((const __m256i *)(in + p + 1));
+		m = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero)));
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 32;
+	}
+
+	return scan_tail(in, p, len);
+}
+
+#elif defined(SCAN_SSE2)
+
+const char *scan_impl_name(void)
+{
+	return "sse2";
+}
+
+int scan_zero_pair(const char *buf, int len)
+{
+	const unsigned char *in = (const unsigned char *)buf;
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, b;
+	unsigned int m;
+	int p = 0;
+
+	if (len < 2)
+		return 0;
+
+	/* Compare the block and the block shifted by one byte against zero,
+	 * the bits set in both masks mark the zero pairs */
+	while (p + 17 <= len) {
+		a = _mm_loadu_si128((const __m128i *)(in + p));
+		b = _mm_loadu_si128((const __m128i *)(in + p + 1));
+		m = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)));
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+
+	return scan_tail(in, p, len);
+}
+
+#elif defined(SCAN_NEON)
+
+const char *scan_impl_name(void)
+{
+	return "neon";
+}
+
+int scan_zero_pair(const char *buf, int len)
+{
+	const unsigned char *in = (const unsigned char *)buf;
+	const uint8x16_t zero = vdupq_n_u8(0);
+	uint8x16_t m;
+	uint64x2_t m64;
+	int p = 0;
+
+	if (len < 2)
+		return 0;
+
+	/* NEON has no movemask, so only check whether any pair is present
+	 * in the block and locate it with the byte-wise loop */
+	while (p + 17 <= len) {
+		m = vandq_u8(vceqq_u8(vld1q_u8(in + p), zero),
+			     vceqq_u8(vld1q_u8(in + p + 1), zero));
+		m64 = vreinterpretq_u64_u8(m);
+		if (vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1))
+			return scan_tail(in, p, p + 17);
+		p += 16;
+	}
+
+	return scan_tail(in, p, len);
+}
+
+#else /* SCAN_WORD */
+
+/* Set the top bit of every byte of the word that was zero (and possibly
+ * of some bytes above it, this is only used to detect a zero byte) */
+#define ONES		(~0UL / 0xff)
+#define HIGHS		(ONES * 0x80)
+#define HAS_ZERO(x)	(((x) - ONES) & ~(x) & HIGHS)
+
+const char *scan_impl_name(void)
+{
+	return "word";
+}
+
+int scan_zero_pair(const char *buf, int len)
+{
+	const unsigned char *in = (const unsigned char *)buf;
+	const int w = sizeof(unsigned long);
+	unsigned long v;
+	int p = 0;
+	int n;
+
+	if (len < 2)
+		return 0;
+
+	/* A pair can only start in a word that contains a zero byte */
+	while (p + w < len) {
+		memcpy(&v, in + p, w);
+		if (HAS_ZERO(v)) {
+			for (n = p; n < p + w; n++)
+				if (in[n] == 0 && in[n + 1] == 0)
+					return n;
+		}
+		p += w;
+	}
+
+	return scan_tail(in, p, len);
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Start code scanner header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_SCAN_H
+#define INCLUDE_SCAN_H
+
+/* When set the parsers do not use the scanner and walk the whole stream
+ * byte by byte. This is used by the benchmark to compare both variants. */
+extern int scan_bytewise;
+
+/* Find the first candidate for a start code. A candidate is a position p
+ * at which two consecutive zero bytes start (in[p] == 0 && in[p + 1] == 0).
+ * All start codes used by the parsers (00 00 01 and the 00 00 8x short
+ * header of H263) begin with such a pair.
+ * Return value: the offset of the candidate or len - 1 if there is none.
+ * The last byte is never skipped as its successor is unknown. */
+int scan_zero_pair(const char *in, int len);
+
+/* Name of the scanner implementation chosen at compile time */
+const char *scan_impl_name(void);
+
+#endif /* INCLUDE_SCAN_H */
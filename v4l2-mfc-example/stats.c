@@ -0,0 +1,182 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Bitstream statistics
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "parser.h"
+#include "stats.h"
+
+/* Descriptor of the original stdout when the statistics are written to it */
+static int stats_stdout = -1;
+
+static void range_add(struct stats_range *r, unsigned int v)
+{
+	if (!r->count || v < r->min)
+		r->min = v;
+	if (v > r->max)
+		r->max = v;
+	r->count++;
+	r->total += v;
+}
+
+void stats_frame(struct parser_stats *s, int size, int flags, int coding)
+{
+	int n;
+
+	s->frames++;
+	range_add(&s->size, size);
+	n = size ? 31 - __builtin_clz(size) : 0;
+	s->size_hist[n]++;
+
+	if (flags & PARSER_FRAME_HEAD) {
+		if (s->headers)
+			range_add(&s->head_gap, s->head_cur);
+		s->headers++;
+		s->head_cur = 0;
+	}
+
+	if (!(flags & PARSER_FRAME_PIC))
+		return;
+
+	/* Without the picture header the key frames are known to be intra
+	 * coded anyway */
+	if (coding == PARSER_CODING_UNKNOWN && (flags & PARSER_FRAME_KEY))
+		coding = PARSER_CODING_I;
+
+	s->pictures++;
+	s->head_cur++;
+	s->coding[coding]++;
+	s->coding_bytes[coding] += size;
+
+	if (flags & PARSER_FRAME_KEY) {
+		s->keys++;
+		if (s->gop_cur)
+			range_add(&s->gop, s->gop_cur);
+		s->gop_cur = 1;
+	} else if (s->gop_cur) {
+		s->gop_cur++;
+	}
+}
+
+static void write_range(FILE *f, const char *name, struct stats_range *r)
+{
+	fprintf(f, "\t\"%s\": {\"count\": %u, \"min\": %u, \"max\": %u, "
+		"\"mean\": %.1f},\n", name, r->count, r->min, r->max,
+		r->count ? (double)r->total / r->count : 0.0);
+}
+
+int stats_open(const char *name)
+{
+	if (strcmp(name, "-") != 0)
+		return 0;
+
+	fflush(stdout);
+	stats_stdout = dup(STDOUT_FILENO);
+	if (stats_stdout < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		err("Failed to redirect stdout to stderr");
+		return -1;
+	}
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	return 0;
+}
+
+int stats_write(struct parser_stats *s, const char *name,
+							unsigned long codec)
+{
+	static const char *coding_names[4] = { "unknown", "I", "P", "B" };
+	struct stats_range gop;
+	const char *sep;
+	FILE *f;
+	int n;
+
+	if (strcmp(name, "-") == 0)
+		f = fdopen(stats_stdout, "w");
+	else
+		f = fopen(name, "w");
+	if (!f) {
+		err("Failed to create the statistics file %s", name);
+		return -1;
+	}
+
+	/* The last GOP ends with the stream */
+	gop = s->gop;
+	if (s->gop_cur)
+		range_add(&gop, s->gop_cur);
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"codec\": \"%c%c%c%c\",\n", (int)(codec & 0xff),
+		(int)(codec >> 8 & 0xff), (int)(codec >> 16 & 0xff),
+		(int)(codec >> 24 & 0xff));
+	fprintf(f, "\t\"frames\": %u,\n", s->frames);
+	fprintf(f, "\t\"bytes\": %llu,\n", (unsigned long long)s->size.total);
+	fprintf(f, "\t\"headers\": %u,\n", s->headers);
+	fprintf(f, "\t\"pictures\": %u,\n", s->pictures);
+	fprintf(f, "\t\"key_frames\": %u,\n", s->keys);
+	write_range(f, "frame_size", &s->size);
+
+	fprintf(f, "\t\"frame_size_histogram\": [");
+	sep = "";
+	for (n = 0; n < STATS_SIZE_BUCKETS; n++) {
+		if (!s->size_hist[n])
+			continue;
+		fprintf(f, "%s\n\t\t{\"min\": %u, \"max\": %u, \"frames\": %u}",
+			sep, n ? 1u << n : 0, (1u << n << 1) - 1,
+			s->size_hist[n]);
+		sep = ",";
+	}
+	fprintf(f, "\n\t],\n");
+
+	fprintf(f, "\t\"coding\": {");
+	sep = "";
+	for (n = 0; n < 4; n++) {
+		fprintf(f, "%s\n\t\t\"%s\": {\"pictures\": %u, \"bytes\": %llu}",
+			sep, coding_names[n], s->coding[n],
+			(unsigned long long)s->coding_bytes[n]);
+		sep = ",";
+	}
+	fprintf(f, "\n\t},\n");
+
+	write_range(f, "gop_length", &gop);
+	write_range(f, "header_interval", &s->head_gap);
+
+	fprintf(f, "\t\"units\": [");
+	sep = "";
+	for (n = 0; n < STATS_UNIT_TYPES; n++) {
+		if (!s->units[n])
+			continue;
+		fprintf(f, "%s\n\t\t{\"type\": %d, \"count\": %u}", sep, n,
+								s->units[n]);
+		sep = ",";
+	}
+	fprintf(f, "\n\t]\n}\n");
+
+	if (fclose(f)) {
+		err("Failed to write the statistics file %s", name);
+		return -1;
+	}
+
+	return 0;
+}
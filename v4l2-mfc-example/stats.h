@@ -0,0 +1,79 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * Bitstream statistics
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_STATS_H
+#define INCLUDE_STATS_H
+
+#include <stdint.h>
+
+/* Number of unit types that are counted, enough for the start code values
+ * of the MPEG codecs and VC1 and for the H264 and HEVC NAL unit types */
+#define STATS_UNIT_TYPES	256
+/* Frame sizes are counted in power of two ranges */
+#define STATS_SIZE_BUCKETS	32
+
+/* Minimum, maximum and sum of a series of values */
+struct stats_range {
+	unsigned int count;
+	unsigned int min;
+	unsigned int max;
+	uint64_t total;
+};
+
+/* Statistics of the stream gathered while it is parsed. The units are
+ * counted by the parser (see the stats member of its context), the frames
+ * when they are extracted. */
+struct parser_stats {
+	unsigned int units[STATS_UNIT_TYPES];
+	unsigned int frames;
+	unsigned int headers;
+	unsigned int pictures;
+	unsigned int keys;
+	/* Sizes of all frames and the number of frames of size between 2^n
+	 * and 2^(n+1)-1 */
+	struct stats_range size;
+	unsigned int size_hist[STATS_SIZE_BUCKETS];
+	/* Frames and bytes of each coding type (PARSER_CODING_*) */
+	unsigned int coding[4];
+	uint64_t coding_bytes[4];
+	/* Pictures from a key frame to the next one. The pictures before
+	 * the first key frame do not belong to any GOP. */
+	struct stats_range gop;
+	unsigned int gop_cur;
+	/* Pictures between the frames that repeat the stream headers */
+	struct stats_range head_gap;
+	unsigned int head_cur;
+};
+
+/* Account an extracted frame */
+void	stats_frame(struct parser_stats *s, int size, int flags, int coding);
+/* Prepare writing the statistics to the named file. For "-" (stdout) the
+ * messages of the application are sent to stderr from now on, so that
+ * stdout only gets the JSON.
+ * Return value: 0 on success, -1 on error */
+int	stats_open(const char *name);
+/* Write the statistics as JSON to the named file, "-" is stdout.
+ * Return value: 0 on success, -1 on error */
+int	stats_write(struct parser_stats *s, const char *name,
+							unsigned long codec);
+
+#endif /* INCLUDE_STATS_H */
@@ -0,0 +1,289 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * MPEG transport stream demultiplexer
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "common.h"
+#include "ts.h"
+
+#define TS_SYNC_BYTE		0x47
+#define TS_PAT_PID		0x0000
+#define TS_NULL_PID		0x1FFF
+
+/* Offset of the sync byte in the packet */
+#define TS_SYNC_OFFS(ts)	((ts)->packet_size - 188)
+
+static int ts_sync_at(const unsigned char *p, int len, int offs, int size)
+{
+	int n;
+
+	for (n = 0; n < TS_PROBE_PACKETS; n++) {
+		if (offs + n * size >= len)
+			return 0;
+		if (p[offs + n * size] != TS_SYNC_BYTE)
+			return 0;
+	}
+	return 1;
+}
+
+int ts_probe(const char *p, int len)
+{
+	const unsigned char *u = (const unsigned char *)p;
+
+	if (ts_sync_at(u, len, 0, 188))
+		return 188;
+	if (ts_sync_at(u, len, 4, 192))
+		return 192;
+	return 0;
+}
+
+void ts_init(struct ts_demux *ts, unsigned long codec, int pid,
+							int packet_size)
+{
+	memzero(*ts);
+	ts->codec = codec;
+	ts->pid = pid;
+	ts->packet_size = packet_size;
+	ts->cc = -1;
+}
+
+/* Check whether the stream_type of the PMT matches the codec */
+static int ts_stream_type_match(unsigned long codec, int type)
+{
+	switch (codec) {
+	case V4L2_PIX_FMT_H264:
+		return type == 0x1B;
+	case V4L2_PIX_FMT_HEVC:
+		return type == 0x24;
+	case V4L2_PIX_FMT_MPEG1:
+	case V4L2_PIX_FMT_MPEG2:
+		return type == 0x01 || type == 0x02;
+	case V4L2_PIX_FMT_MPEG4:
+	case V4L2_PIX_FMT_XVID:
+	case V4L2_PIX_FMT_H263:
+		return type == 0x10;
+	}
+	return 0;
+}
+
+static void ts_parse_pat(struct ts_demux *ts, unsigned char *s, int len)
+{
+	int n;
+
+	/* The program loop follows the 8 byte header and is followed
+	 * by CRC */
+	for (n = 8; n + 4 <= len - 4; n += 4) {
+		if (((s[n] << 8) | s[n + 1]) == 0)
+			/* Network PID */
+			continue;
+		ts->pmt_pid = ((s[n + 2] & 0x1F) << 8) | s[n + 3];
+		dbg("Found PMT at PID %d", ts->pmt_pid);
+		return;
+	}
+}
+
+static void ts_parse_pmt(struct ts_demux *ts, unsigned char *s, int len)
+{
+	int type, pid;
+	int n;
+
+	/* Skip the header and program_info */
+	n = 12 + (((s[10] & 0x0F) << 8) | s[11]);
+	for (; n + 5 <= len - 4; n += 5 + (((s[n + 3] & 0x0F) << 8) | s[n + 4])) {
+		type = s[n];
+		pid = ((s[n + 1] & 0x1F) << 8) | s[n + 2];
+		if (ts_stream_type_match(ts->codec, type)) {
+			dbg("Using stream of type 0x%02x at PID %d", type, pid);
+			ts->pid = pid;
+			return;
+		}
+	}
+
+	err("No stream of the chosen codec found in the transport stream");
+}
+
+/* Assemble the PAT and PMT sections */
+static void ts_section(struct ts_demux *ts, int pid, int start,
+					unsigned char *p, int len)
+{
+	int n;
+
+	if (start) {
+		/* pointer_field */
+		if (p[0] >= len)
+			return;
+		len -= p[0] + 1;
+		p += p[0] + 1;
+		ts->section_len = 0;
+		ts->section_pid = pid;
+	} else if (ts->section_pid != pid || ts->section_len == 0) {
+		return;
+	}
+
+	n = TS_MAX_SECTION - ts->section_len;
+	if (len > n)
+		len = n;
+	memcpy(ts->section + ts->section_len, p, len);
+	ts->section_len += len;
+
+	if (ts->section_len < 3)
+		return;
+	n = 3 + (((ts->section[1] & 0x0F) << 8) | ts->section[2]);
+	if (ts->section_len < n)
+		return;
+	/* Only the PMT of the first program is used, so a complete section
+	 * is parsed once */
+	ts->section_pid = -1;
+	if (n < 12 || n > TS_MAX_SECTION)
+		return;
+
+	if (pid == TS_PAT_PID && ts->section[0] == 0x00)
+		ts_parse_pat(ts, ts->section, n);
+	else if (pid == ts->pmt_pid && ts->section[0] == 0x02)
+		ts_parse_pmt(ts, ts->section, n);
+}
+
+/* Strip the PES header and pass the payload */
+static void ts_pes(struct ts_demux *ts, int start, unsigned char *p, int len,
+						ts_out_func out, void *priv)
+{
+	int n;
+
+	if (start) {
+		ts->pes_started = 1;
+		ts->pes_hdr_len = 0;
+		ts->pes_skip = 0;
+	} else if (!ts->pes_started) {
+		/* Wait for the beginning of a PES packet */
+		return;
+	}
+
+	if (ts->pes_hdr_len < sizeof(ts->pes_hdr)) {
+		n = sizeof(ts->pes_hdr) - ts->pes_hdr_len;
+		if (n > len)
+			n = len;
+		memcpy(ts->pes_hdr + ts->pes_hdr_len, p, n);
+		ts->pes_hdr_len += n;
+		p += n;
+		len -= n;
+		if (ts->pes_hdr_len < sizeof(ts->pes_hdr))
+			return;
+
+		if (ts->pes_hdr[0] != 0 || ts->pes_hdr[1] != 0 ||
+							ts->pes_hdr[2] != 1) {
+			err("Invalid PES header");
+			ts->errors++;
+			ts->pes_started = 0;
+			return;
+		}
+		/* The video streams have the optional PES header, its
+		 * length is in the last byte of pes_hdr */
+		ts->pes_skip = ts->pes_hdr[8];
+	}
+
+	n = ts->pes_skip < len ? ts->pes_skip : len;
+	ts->pes_skip -= n;
+	p += n;
+	len -= n;
+
+	if (len > 0)
+		out(priv, (const char *)p, len);
+}
+
+static void ts_packet(struct ts_demux *ts, unsigned char *p, ts_out_func out,
+								void *priv)
+{
+	int pid, start, afc, cc;
+	int offs = 4;
+
+	pid = ((p[1] & 0x1F) << 8) | p[2];
+	start = p[1] & 0x40;
+	afc = (p[3] >> 4) & 0x3;
+	cc = p[3] & 0xF;
+
+	if ((p[1] & 0x80) || pid == TS_NULL_PID)
+		/* transport_error_indicator */
+		return;
+
+	if (afc & 0x2)
+		/* adaptation_field */
+		offs += 1 + p[4];
+	if (!(afc & 0x1) || offs >= 188)
+		/* No payload */
+		return;
+
+	if (ts->pid && pid == ts->pid) {
+		if (ts->cc >= 0) {
+			if (cc == ts->cc)
+				/* Duplicate packet */
+				return;
+			if (cc != ((ts->cc + 1) & 0xF)) {
+				dbg("Discontinuity in the transport stream");
+				ts->errors++;
+			}
+		}
+		ts->cc = cc;
+		ts_pes(ts, start, p + offs, 188 - offs, out, priv);
+	} else if (ts->pid == 0 && (pid == TS_PAT_PID ||
+				(ts->pmt_pid && pid == ts->pmt_pid))) {
+		ts_section(ts, pid, start, p + offs, 188 - offs);
+	}
+}
+
+int ts_demux(struct ts_demux *ts, const char *in, int len, ts_out_func out,
+								void *priv)
+{
+	const unsigned char *u = (const unsigned char *)in;
+	const unsigned char *s;
+	int offs = TS_SYNC_OFFS(ts);
+	int pos = 0;
+
+	while (pos + ts->packet_size <= len) {
+		if (u[pos + offs] != TS_SYNC_BYTE) {
+			/* Look for the next sync byte that is followed by
+			 * another one a packet later */
+			ts->errors++;
+			s = u + pos + offs + 1;
+			while (1) {
+				s = memchr(s, TS_SYNC_BYTE, u + len - s);
+				if (!s || s + ts->packet_size >= u + len)
+					break;
+				if (s[ts->packet_size] == TS_SYNC_BYTE)
+					break;
+				s++;
+			}
+			if (!s) {
+				/* Keep the partial packet at the end */
+				pos = len - ts->packet_size + 1;
+				break;
+			}
+			dbg("Lost sync in the transport stream");
+			pos = s - u - offs;
+			continue;
+		}
+
+		ts_packet(ts, (unsigned char *)u + pos + offs, out, priv);
+		pos += ts->packet_size;
+	}
+
+	return pos;
+}
@@ -0,0 +1,75 @@
+/*
+ * V4L2 Codec decoding example application
+ * Kamil Debski <k.debski@samsung.com>
+ *
+ * MPEG transport stream demultiplexer header file
+ *
+ * Copyright 2012 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef INCLUDE_TS_H
+#define INCLUDE_TS_H
+
+/* Maximum size of a PSI section (PAT and PMT) */
+#define TS_MAX_SECTION		1024
+
+/* Number of packets that ts_probe needs to detect a transport stream */
+#define TS_PROBE_PACKETS	3
+/* Number of bytes that ts_probe needs (for 192 byte packets) */
+#define TS_PROBE_SIZE		(TS_PROBE_PACKETS * 192)
+
+/* Callback that receives the payload of the elementary stream */
+typedef void (*ts_out_func)(void *priv, const char *p, int len);
+
+struct ts_demux {
+	/* V4L2 format of the elementary stream */
+	unsigned long codec;
+	/* PID of the elementary stream. If 0 then the first stream of the
+	 * codec listed in the PMT is used. */
+	int pid;
+	/* 188 or 192 (with the 4 byte timestamp of M2TS) */
+	int packet_size;
+	int pmt_pid;
+	/* Continuity counter of the recent packet of the stream */
+	int cc;
+	/* Set when the beginning of a PES packet has been found */
+	int pes_started;
+	/* Beginning of the PES header and the number of header bytes that
+	 * are still to be skipped */
+	unsigned char pes_hdr[9];
+	int pes_hdr_len;
+	int pes_skip;
+	/* PSI section that is being assembled */
+	unsigned char section[TS_MAX_SECTION];
+	int section_len;
+	int section_pid;
+	/* Number of lost sync bytes and continuity errors */
+	int errors;
+};
+
+/* Check if the data is a transport stream. Returns the packet size or 0. */
+int	ts_probe(const char *p, int len);
+/* Initialise the demultiplexer. If pid is 0 then the stream is chosen
+ * using the PMT. */
+void	ts_init(struct ts_demux *ts, unsigned long codec, int pid,
+							int packet_size);
+/* Demultiplex the complete packets in the data and pass the payload of the
+ * elementary stream to out. Returns the number of bytes used, the rest
+ * has to be passed again together with the following data. */
+int	ts_demux(struct ts_demux *ts, const char *in, int len, ts_out_func out,
+								void *priv);
+
+#endif /* INCLUDE_TS_H */